@@ -0,0 +1,247 @@
+/**********************************************************************************************************************
+*
+*   File:           pb_command.c
+*
+*   Summary:        Local command socket - virtual presses and direct action requests
+*
+*   Element:        IESv06
+*
+*   Platform:       Linux
+*
+*   Description:  Socket set-up, peer authentication and command parsing (see pb_command.h).
+*                 Commands are carried out by libpbmon (pbmon.c) in its own dispatch, so they
+*                 take the same state machine, LED and action path as the button.
+*
+*******************************************************************************************************************/
+
+#define _GNU_SOURCE             /* struct ucred */
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+
+#include "pb_command.h"
+#include "pb_flightrec.h"
+
+/*
+ * Static - action names, as enum fr_decision
+ */
+static const struct {
+	const char   *name;
+	unsigned int decision;
+} cmd_actions[] = {
+	{ "reboot",             FR_DEC_REBOOT },
+	{ "factory-reset",      FR_DEC_FACTORY_RESET },
+	{ "factory-reset-next", FR_DEC_FACTORY_RESET_NEXT },
+	{ "shutdown",           FR_DEC_SHUTDOWN },
+	{ "cancel",             FR_DEC_CANCEL },
+};
+
+/*
+ **************  Functions  ****************
+ */
+
+/*
+ * cmd_open
+ *
+ * @brief Creates the listening socket at path, group gid (CMD_NO_GROUP - root only).
+ * @return listening fd, or -1 on failure.
+ */
+int cmd_open( const char *path, gid_t gid )
+{
+	struct sockaddr_un addr;
+	int fd;
+
+	if (strlen(path) >= sizeof(addr.sun_path))
+	{
+		printf("%s: socket path too long\n", path);
+		return(-1);
+	}
+	fd = socket(AF_UNIX, SOCK_SEQPACKET | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+	if (fd == -1)
+	{
+		perror("command socket");
+		return(-1);
+	}
+	memset(&addr, 0, sizeof(addr));
+	addr.sun_family = AF_UNIX;
+	strcpy(addr.sun_path, path);
+	/* Left over from a previous run */
+	unlink(path);
+	if ((bind(fd, (struct sockaddr *)&addr, sizeof(addr)) == -1) ||
+	    (chmod(path, (gid == CMD_NO_GROUP) ? 0600 : 0660) == -1) ||
+	    ((gid != CMD_NO_GROUP) && (chown(path, -1, gid) == -1)) ||
+	    (listen(fd, CMD_CLIENTS) == -1))
+	{
+		perror(path);
+		close(fd);
+		unlink(path);
+		return(-1);
+	}
+	printf("Command socket %s\n", path);
+	return(fd);
+}
+
+/*
+ * cmd_in_group
+ *
+ * @brief Is the peer on fd in group gid, as its primary or a supplementary group?
+ *        The supplementary groups are from SO_PEERGROUPS (as at connect). Without
+ *        it (kernels before 4.13) only the primary group counts - /proc/<pid>/status
+ *        could describe another process by the time it is read.
+ */
+static int cmd_in_group( int fd, const struct ucred *cred, gid_t gid )
+{
+#ifdef SO_PEERGROUPS
+	gid_t groups[CMD_GROUPS];
+	socklen_t len = sizeof(groups);
+	unsigned int i;
+#endif
+
+	if (cred->gid == gid)
+		return(1);
+#ifdef SO_PEERGROUPS
+	if (getsockopt(fd, SOL_SOCKET, SO_PEERGROUPS, groups, &len) == 0)
+	{
+		for (i = 0; i < len / sizeof(gid_t); i++)
+		{
+			if (groups[i] == gid)
+				return(1);
+		}
+	}
+	else if (errno != ENOPROTOOPT)
+	{
+		perror("SO_PEERGROUPS");
+	}
+#endif
+	return(0);
+}
+
+/*
+ * cmd_accept
+ *
+ * @brief Accepts a connection and authenticates the peer (root, own user or a member
+ *        of gid).
+ * @return connected fd (non-blocking), or -1 if none or refused.
+ */
+int cmd_accept( int listen_fd, gid_t gid )
+{
+	struct ucred cred;
+	socklen_t len = sizeof(cred);
+	int fd;
+
+	fd = accept4(listen_fd, NULL, NULL, SOCK_NONBLOCK | SOCK_CLOEXEC);
+	if (fd == -1)
+	{
+		if ((errno != EAGAIN) && (errno != EINTR))
+			perror("command accept");
+		return(-1);
+	}
+	if (getsockopt(fd, SOL_SOCKET, SO_PEERCRED, &cred, &len) == -1)
+	{
+		perror("SO_PEERCRED");
+		close(fd);
+		return(-1);
+	}
+	if ((cred.uid != 0) && (cred.uid != geteuid()) &&
+	    ((gid == CMD_NO_GROUP) || !cmd_in_group(fd, &cred, gid)))
+	{
+		printf("Command socket: refused pid %d uid %u\n", (int)cred.pid, (unsigned int)cred.uid);
+		cmd_reply(fd, "error not authorised");
+		close(fd);
+		return(-1);
+	}
+	return(fd);
+}
+
+/*
+ * cmd_parse
+ *
+ * @brief Parses one command line.
+ * @return 0, or -1 if not a valid command.
+ */
+int cmd_parse( const char *line, struct cmd *cmd )
+{
+	unsigned int i;
+
+	if (strcmp(line, "press") == 0)
+		cmd->op = CMD_PRESS;
+	else if (strcmp(line, "release") == 0)
+		cmd->op = CMD_RELEASE;
+	else if (strcmp(line, "state") == 0)
+		cmd->op = CMD_STATE;
+	else if (strncmp(line, "action ", 7) == 0)
+	{
+		for (i = 0; i < sizeof(cmd_actions) / sizeof(cmd_actions[0]); i++)
+		{
+			if (strcmp(line + 7, cmd_actions[i].name) == 0)
+			{
+				cmd->op = CMD_ACTION;
+				cmd->decision = cmd_actions[i].decision;
+				return(0);
+			}
+		}
+		return(-1);
+	}
+	else
+		return(-1);
+	return(0);
+}
+
+/*
+ * cmd_receive
+ *
+ * @brief Reads one command from a connection. Invalid commands are answered here.
+ * @return 1 command in cmd, 0 nothing to do, -1 connection closed (caller closes fd).
+ */
+int cmd_receive( int fd, struct cmd *cmd )
+{
+	char line[CMD_LEN];
+	ssize_t len;
+
+	len = recv(fd, line, sizeof(line) - 1, 0);
+	if (len == -1)
+		return(((errno == EAGAIN) || (errno == EINTR)) ? 0 : -1);
+	if (len == 0)
+		return(-1);
+	/* "press\n" from a shell is the same command */
+	while ((len > 0) && ((line[len - 1] == '\n') || (line[len - 1] == '\r')))
+		len--;
+	line[len] = '\0';
+	if (cmd_parse(line, cmd) < 0)
+	{
+		cmd_reply(fd, "error unknown command");
+		return(0);
+	}
+	return(1);
+}
+
+/*
+ * cmd_reply
+ *
+ * @brief Sends a reply - one message, never blocks.
+ * @return 0, or -1 on failure.
+ */
+int cmd_reply( int fd, const char *reply )
+{
+	if (send(fd, reply, strlen(reply), MSG_DONTWAIT | MSG_NOSIGNAL) == -1)
+		return(-1);
+	return(0);
+}
+
+/*
+ * cmd_close
+ *
+ * @brief Closes the listening socket and removes its file.
+ */
+void cmd_close( const char *path, int listen_fd )
+{
+	if (listen_fd == -1)
+		return;
+	close(listen_fd);
+	unlink(path);
+}
@@ -0,0 +1,67 @@
+/**********************************************************************************************************************
+*
+*   File:           pb_command.h
+*
+*   Summary:        Local command socket - virtual presses and direct action requests
+*
+*   Element:        IESv06
+*
+*   Platform:       Linux
+*
+*   Description:  A SOCK_SEQPACKET Unix socket, one command per message, one reply each:
+*
+*                   press                   virtual button press
+*                   release                 virtual release - timed and classified as a real one
+*                   action <name>           carry out a classified press directly:
+*                                           reboot, factory-reset (start-up window only),
+*                                           factory-reset-next, shutdown, cancel
+*                   state                   "ok start|in-use pressed|released"
+*
+*                 Replies are "ok..." or "error <reason>". Peers are authenticated with
+*                 SO_PEERCRED: root, the monitor's own user, or a member (primary or,
+*                 from Linux 4.13, supplementary group) of the group given to cmd_open(),
+*                 which also owns the socket file, mode 0660.
+*
+*                   socat - UNIX-CONNECT:/run/pb_monitor.sock,type=5
+*
+*******************************************************************************************************************/
+#ifndef PB_COMMAND_H
+#define PB_COMMAND_H
+
+#include <sys/types.h>
+
+/*
+ * Defines
+ */
+#define CMD_SOCKET          "/run/pb_monitor.sock"
+#define CMD_CLIENTS         4       /* connections served at once */
+#define CMD_LEN             64      /* longest command or reply */
+#define CMD_NO_GROUP        ((gid_t)-1)
+#define CMD_GROUPS          64      /* peer supplementary groups checked */
+
+/*
+ * Enumuration - command
+ */
+enum cmd_op {
+	CMD_PRESS,
+	CMD_RELEASE,
+	CMD_ACTION,
+	CMD_STATE
+};
+
+/*
+ * Parsed command
+ */
+struct cmd {
+	enum cmd_op  op;
+	unsigned int decision;      /* enum fr_decision, CMD_ACTION */
+};
+
+int  cmd_open( const char *path, gid_t gid );
+int  cmd_accept( int listen_fd, gid_t gid );
+int  cmd_parse( const char *line, struct cmd *cmd );
+int  cmd_receive( int fd, struct cmd *cmd );
+int  cmd_reply( int fd, const char *reply );
+void cmd_close( const char *path, int listen_fd );
+
+#endif /* PB_COMMAND_H */
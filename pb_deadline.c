@@ -0,0 +1,328 @@
+/**********************************************************************************************************************
+*
+*   File:           pb_deadline.c
+*
+*   Summary:        Deadline scheduler - many deadlines on one timerfd
+*
+*   Element:        IESv06
+*
+*   Platform:       Linux
+*
+*   Description:  See pb_deadline.h. The timerfd is set to an absolute time, and only when
+*                 the earliest deadline changes, so re-arming a later deadline costs no
+*                 system call.
+*
+*******************************************************************************************************************/
+
+#include <errno.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/timerfd.h>
+
+#include "pb_deadline.h"
+#include "pb_latency.h"
+#include "pb_probes.h"
+
+/*
+ * Static
+ */
+static struct dl_timer *dl_heap[DL_MAX];
+static unsigned int dl_count;
+static int dl_fd = -1;
+static uint64_t dl_programmed_ns;   /* timerfd expiry, 0 if disarmed */
+
+/*
+ **************  Functions  ****************
+ */
+
+/*
+ * dl_place
+ *
+ * @brief Puts timer in heap slot i.
+ */
+static void dl_place( unsigned int i, struct dl_timer *timer )
+{
+	dl_heap[i] = timer;
+	timer->index = i;
+}
+
+/*
+ * dl_sift_up
+ *
+ * @brief Moves the timer in slot i up to its place.
+ */
+static void dl_sift_up( unsigned int i )
+{
+	struct dl_timer *timer = dl_heap[i];
+	unsigned int parent;
+
+	while (i > 0)
+	{
+		parent = (i - 1) / 2;
+		if (dl_heap[parent]->deadline_ns <= timer->deadline_ns)
+			break;
+		dl_place(i, dl_heap[parent]);
+		i = parent;
+	}
+	dl_place(i, timer);
+}
+
+/*
+ * dl_sift_down
+ *
+ * @brief Moves the timer in slot i down to its place.
+ */
+static void dl_sift_down( unsigned int i )
+{
+	struct dl_timer *timer = dl_heap[i];
+	unsigned int child;
+
+	for (;;)
+	{
+		child = (2 * i) + 1;
+		if (child >= dl_count)
+			break;
+		if ((child + 1 < dl_count) && (dl_heap[child + 1]->deadline_ns < dl_heap[child]->deadline_ns))
+			child++;
+		if (timer->deadline_ns <= dl_heap[child]->deadline_ns)
+			break;
+		dl_place(i, dl_heap[child]);
+		i = child;
+	}
+	dl_place(i, timer);
+}
+
+/*
+ * dl_pop
+ *
+ * @brief Removes the earliest timer from the heap.
+ */
+static struct dl_timer *dl_pop( void )
+{
+	struct dl_timer *top = dl_heap[0];
+
+	top->index = -1;
+	if (--dl_count > 0)
+	{
+		dl_place(0, dl_heap[dl_count]);
+		dl_sift_down(0);
+	}
+	return(top);
+}
+
+/*
+ * dl_compact
+ *
+ * @brief Drops every cancelled timer and rebuilds the heap - O(n), only when full.
+ */
+static void dl_compact( void )
+{
+	unsigned int i, n = 0;
+
+	for (i = 0; i < dl_count; i++)
+	{
+		if (dl_heap[i]->armed)
+			dl_place(n++, dl_heap[i]);
+		else
+			dl_heap[i]->index = -1;
+	}
+	dl_count = n;
+	for (i = dl_count / 2; i-- > 0; )
+		dl_sift_down(i);
+}
+
+/*
+ * dl_program
+ *
+ * @brief Sets the timerfd to the earliest deadline, if that has changed.
+ */
+static void dl_program( void )
+{
+	struct itimerspec its;
+	uint64_t next;
+
+	if (dl_fd == -1)
+		return;
+	next = dl_next();
+	if (next == dl_programmed_ns)
+		return;
+	memset(&its, 0, sizeof(its));
+	its.it_value.tv_sec = next / 1000000000ULL;
+	its.it_value.tv_nsec = next % 1000000000ULL;
+	/* An absolute time already passed expires at once */
+	if (timerfd_settime(dl_fd, TFD_TIMER_ABSTIME, &its, NULL) != 0)
+	{
+		printf("timerfd_settime failed:%d -(%s)\n", errno, strerror(errno));
+		return;
+	}
+	dl_programmed_ns = next;
+}
+
+/*
+ * dl_timer_init
+ *
+ * @brief Initialises a deadline, not armed, that calls fire(timer, late_ns) when due.
+ */
+void dl_timer_init( struct dl_timer *timer, dl_fire_fn fire, void *ctx )
+{
+	timer->deadline_ns = 0;
+	timer->fire = fire;
+	timer->ctx = ctx;
+	timer->index = -1;
+	timer->armed = 0;
+}
+
+/*
+ * dl_open
+ *
+ * @brief Creates the timerfd that dl_add() / dl_expire() keep programmed.
+ * @return timer file descriptor, readable when a deadline is due, or -1 on failure.
+ */
+int dl_open( void )
+{
+	dl_fd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+	if (dl_fd == -1)
+	{
+		perror("timerfd_create");
+		return(-1);
+	}
+	dl_programmed_ns = 0;
+	dl_program();
+	return(dl_fd);
+}
+
+/*
+ * dl_add
+ *
+ * @brief Arms timer for deadline_ns, or moves it there if already armed.
+ * @return 0, or -1 if DL_MAX deadlines are pending.
+ */
+int dl_add( struct dl_timer *timer, uint64_t deadline_ns )
+{
+	timer->deadline_ns = deadline_ns;
+	timer->armed = 1;
+	if (timer->index >= 0)
+	{
+		/* Still in the heap (possibly cancelled) - re-arm in place */
+		dl_sift_up(timer->index);
+		dl_sift_down(timer->index);
+	}
+	else
+	{
+		if (dl_count == DL_MAX)
+			dl_compact();
+		if (dl_count == DL_MAX)
+		{
+			timer->armed = 0;
+			printf("Deadline scheduler full (%d)\n", DL_MAX);
+			return(-1);
+		}
+		dl_place(dl_count++, timer);
+		dl_sift_up(timer->index);
+	}
+	dl_program();
+	return(0);
+}
+
+/*
+ * dl_cancel
+ *
+ * @brief Disarms timer - O(1), it leaves the heap lazily, so it must stay valid
+ *        until its index is -1 (or use dl_remove()).
+ */
+void dl_cancel( struct dl_timer *timer )
+{
+	timer->armed = 0;
+}
+
+/*
+ * dl_remove
+ *
+ * @brief Disarms timer and takes it out of the heap at once - O(log n). The
+ *        scheduler holds no reference to it afterwards, so it may be freed.
+ */
+void dl_remove( struct dl_timer *timer )
+{
+	struct dl_timer *last;
+	int i = timer->index;
+
+	timer->armed = 0;
+	if (i < 0)
+		return;
+	timer->index = -1;
+	last = dl_heap[--dl_count];
+	if (last != timer)
+	{
+		/* The last timer fills the hole, then moves up or down to its place */
+		dl_place(i, last);
+		dl_sift_up(i);
+		dl_sift_down(last->index);
+	}
+	dl_program();
+}
+
+/*
+ * dl_next
+ *
+ * @brief Earliest armed deadline, dropping cancelled ones from the top.
+ * @return CLOCK_MONOTONIC ns, or 0 if none is armed.
+ */
+uint64_t dl_next( void )
+{
+	while ((dl_count > 0) && !dl_heap[0]->armed)
+		dl_pop();
+	return((dl_count > 0) ? dl_heap[0]->deadline_ns : 0);
+}
+
+/*
+ * dl_expire
+ *
+ * @brief Fires, earliest first, every deadline due at now_ns, then re-programs the
+ *        timerfd. A callback may re-arm its own or any other deadline - its own for
+ *        after now_ns, or it fires again in this call.
+ * @return number fired.
+ */
+int dl_expire( uint64_t now_ns )
+{
+	struct dl_timer *timer;
+	uint64_t late_ns;
+	int fired = 0;
+
+	while (dl_next() && (dl_heap[0]->deadline_ns <= now_ns))
+	{
+		timer = dl_pop();
+		timer->armed = 0;
+		late_ns = now_ns - timer->deadline_ns;
+		lat_record(&lat_timer, late_ns / 1000);
+		PB_PROBE2(deadline, late_ns, dl_count);
+		timer->fire(timer, late_ns);
+		fired++;
+	}
+	dl_program();
+	return(fired);
+}
+
+/*
+ * dl_close
+ *
+ * @brief Drops every deadline and closes the timerfd.
+ */
+void dl_close( void )
+{
+	struct dl_timer *timer;
+
+	while (dl_count > 0)
+	{
+		timer = dl_heap[--dl_count];
+		timer->index = -1;
+		timer->armed = 0;
+	}
+	if (dl_fd != -1)
+	{
+		close(dl_fd);
+		dl_fd = -1;
+	}
+	dl_programmed_ns = 0;
+}
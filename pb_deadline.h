@@ -0,0 +1,61 @@
+/**********************************************************************************************************************
+*
+*   File:           pb_deadline.h
+*
+*   Summary:        Deadline scheduler - many deadlines on one timerfd
+*
+*   Element:        IESv06
+*
+*   Platform:       Linux
+*
+*   Description:  A binary min-heap of caller-owned deadlines (CLOCK_MONOTONIC ns). The one
+*                 timerfd from dl_open() is kept programmed for the earliest, or a host with
+*                 its own wait (io_uring link timeout) asks dl_next(). dl_expire() fires what
+*                 is due, each callback told how late it ran; lateness also goes to the
+*                 lat_timer histogram and the deadline probe.
+*
+*                 Add and re-arm are O(log n). Cancel is O(1): the deadline is only marked and
+*                 leaves the heap when it reaches the top (the timerfd may then wake once for
+*                 nothing) or when a full heap is compacted. Nothing is allocated.
+*
+*                 The heap holds the caller's dl_timer by pointer, so a cancelled deadline
+*                 must stay valid until its index is -1. An owner that frees it (e.g. a
+*                 per-key struct on key removal) calls dl_remove() instead, O(log n).
+*
+*******************************************************************************************************************/
+#ifndef PB_DEADLINE_H
+#define PB_DEADLINE_H
+
+#include <stdint.h>
+
+/*
+ * Defines
+ */
+#define DL_MAX              4096        /* deadlines pending at once */
+
+struct dl_timer;
+typedef void (*dl_fire_fn)( struct dl_timer *timer, uint64_t late_ns );
+
+/*
+ * Deadline - owned by the caller, initialise with DL_TIMER_INIT or dl_timer_init()
+ */
+struct dl_timer {
+	uint64_t   deadline_ns;     /* CLOCK_MONOTONIC */
+	dl_fire_fn fire;
+	void       *ctx;
+	int        index;           /* heap slot, -1 if not in the heap */
+	int        armed;           /* 0 once fired or cancelled */
+};
+
+#define DL_TIMER_INIT(fire, ctx)    { 0, (fire), (ctx), -1, 0 }
+
+void     dl_timer_init( struct dl_timer *timer, dl_fire_fn fire, void *ctx );
+int      dl_open( void );
+int      dl_add( struct dl_timer *timer, uint64_t deadline_ns );
+void     dl_cancel( struct dl_timer *timer );
+void     dl_remove( struct dl_timer *timer );
+uint64_t dl_next( void );
+int      dl_expire( uint64_t now_ns );
+void     dl_close( void );
+
+#endif /* PB_DEADLINE_H */
@@ -0,0 +1,300 @@
+/**********************************************************************************************************************
+*
+*   File:           pb_flightrec.c
+*
+*   Summary:        Reboot-surviving flight recorder of push-button decisions
+*
+*   Element:        IESv06
+*
+*   Platform:       Linux
+*
+*   Description:  The most common outcome of a press is a reboot, which loses anything
+*                 still in the page cache. The recorder keeps the last FR_RECORDS
+*                 press/release/decision/action records in a preallocated file that is
+*                 memory-mapped once at start-up. Records are written with plain stores;
+*                 fr_flush() does a single msync just before any power action.
+*
+*                 On start-up the records of the previous boot are printed, costing one
+*                 mmap and a walk of FR_RECORDS entries.
+*
+*                 If the kernel has pstore/ramoops with a pmsg area (/dev/pmsg0), fr_flush()
+*                 also writes the recent records there as text; after the reboot they are in
+*                 /sys/fs/pstore/pmsg-ramoops-0 even if the file was not written back. When
+*                 the file cannot be opened or holds no records of the previous boot,
+*                 fr_open() prints that copy instead.
+*
+*******************************************************************************************************************/
+
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "pb_flightrec.h"
+
+/*
+ * Defines
+ */
+#define FR_PMSG_RECORDS     8       /* records copied to pmsg on flush */
+
+/*
+ * Static
+ */
+static struct fr_file *fr_map = NULL;
+static int fr_fd = -1;
+
+/*
+ * Global - where pstore is mounted (tests move it)
+ */
+const char *fr_pstore_dir = FR_PSTORE_DIR;
+
+static const char *fr_type_name[] = {
+	"boot", "press", "release", "decision", "action"
+};
+
+static const char *fr_decision_name[] = {
+	"none", "reboot", "factory-reset-next-boot", "shutdown", "cancel", "factory-reset"
+};
+
+/*
+ **************  Functions  ****************
+ */
+
+/*
+ * fr_format
+ *
+ * @brief Formats one record as a text line into buf.
+ * @return number of characters written.
+ */
+static int fr_format( const struct fr_record *rec, char *buf, size_t len )
+{
+	const char *type = (rec->type <= FR_ACTION) ? fr_type_name[rec->type] : "?";
+
+	if ((rec->type == FR_DECISION) && (rec->value <= FR_DEC_FACTORY_RESET))
+	{
+		return snprintf(buf, len, "pb_flightrec: boot %u #%u %lld.%03u state=%u %s %s\n",
+		                rec->boot, rec->seq, (long long)rec->tv_sec, rec->tv_nsec / 1000000,
+		                rec->state, type, fr_decision_name[rec->value]);
+	}
+	return snprintf(buf, len, "pb_flightrec: boot %u #%u %lld.%03u state=%u %s %u\n",
+	                rec->boot, rec->seq, (long long)rec->tv_sec, rec->tv_nsec / 1000000,
+	                rec->state, type, rec->value);
+}
+
+/*
+ * fr_report_pstore
+ *
+ * @brief Prints the records fr_flush() copied to pmsg in the previous boot, if the
+ *        kernel kept them.
+ */
+static void fr_report_pstore( void )
+{
+	char path[256], line[128];
+	struct dirent *entry;
+	FILE *file;
+	DIR *dir;
+
+	if ((dir = opendir(fr_pstore_dir)) == NULL)
+		return;
+	while ((entry = readdir(dir)) != NULL)
+	{
+		if (strncmp(entry->d_name, FR_PSTORE_PMSG, strlen(FR_PSTORE_PMSG)) != 0)
+			continue;
+		if ((snprintf(path, sizeof(path), "%s/%s", fr_pstore_dir, entry->d_name) >= (int)sizeof(path)) ||
+		    ((file = fopen(path, "r")) == NULL))
+			continue;
+		printf("pb_flightrec: previous boot from %s\n", path);
+		while (fgets(line, sizeof(line), file) != NULL)
+			fputs(line, stdout);
+		fclose(file);
+	}
+	closedir(dir);
+}
+
+/*
+ * fr_report_previous
+ *
+ * @brief Prints the records of the previous boot, oldest first - from pstore if the
+ *        file has none.
+ */
+static void fr_report_previous( void )
+{
+	char line[128];
+	unsigned int i;
+	unsigned int n = 0;
+	const struct fr_record *rec;
+
+	for (i = 1; i <= FR_RECORDS; i++)
+	{
+		rec = &fr_map->rec[(fr_map->seq + i) & (FR_RECORDS - 1)];
+		if ((rec->seq == 0) || (rec->boot != fr_map->boot))
+			continue;
+		fr_format(rec, line, sizeof(line));
+		fputs(line, stdout);
+		n++;
+	}
+	if (n == 0)
+	{
+		printf("pb_flightrec: no records from previous boot\n");
+		fr_report_pstore();
+	}
+}
+
+/*
+ * fr_open
+ *
+ * @brief Maps the flight recorder file, creating and preallocating it if needed,
+ *        reports the previous boot's records and starts a new boot.
+ * @param path - recorder file
+ * @return 0 on success, -1 on failure (recording is then disabled).
+ */
+int fr_open( const char *path )
+{
+	struct stat sts;
+
+	fr_fd = open(path, O_RDWR | O_CREAT, 0644);
+	if (fr_fd == -1)
+	{
+		perror("fr_open");
+		fr_report_pstore();
+		return(-1);
+	}
+	if (fstat(fr_fd, &sts) == -1)
+	{
+		perror("fr_open fstat");
+		goto fail;
+	}
+	if (sts.st_size != sizeof(struct fr_file))
+	{
+		/* Allocate blocks now, so the flush before a power action cannot fail */
+		if ((ftruncate(fr_fd, sizeof(struct fr_file)) == -1) ||
+		    (posix_fallocate(fr_fd, 0, sizeof(struct fr_file)) != 0))
+		{
+			perror("fr_open allocate");
+			goto fail;
+		}
+	}
+	fr_map = mmap(NULL, sizeof(struct fr_file), PROT_READ | PROT_WRITE, MAP_SHARED, fr_fd, 0);
+	if (fr_map == MAP_FAILED)
+	{
+		perror("fr_open mmap");
+		fr_map = NULL;
+		goto fail;
+	}
+
+	if ((fr_map->magic != FR_MAGIC) || (fr_map->version != FR_VERSION))
+	{
+		printf("pb_flightrec: new recorder file %s\n", path);
+		fr_report_pstore();
+		memset(fr_map, 0, sizeof(struct fr_file));
+		fr_map->magic = FR_MAGIC;
+		fr_map->version = FR_VERSION;
+	}
+	else
+	{
+		fr_report_previous();
+	}
+
+	fr_map->boot++;
+	fr_record(FR_BOOT, 0, 0);
+	return(0);
+
+fail:
+	close(fr_fd);
+	fr_fd = -1;
+	fr_report_pstore();
+	return(-1);
+}
+
+/*
+ * fr_record
+ *
+ * @brief Adds a record to the ring. Plain stores only - no system call other than
+ *        the vDSO clock read.
+ * @param type  - record type
+ * @param state - pb_state at the time
+ * @param value - press time in ms, decision or action
+ */
+void fr_record( enum fr_type type, unsigned int state, unsigned long value )
+{
+	struct fr_record *rec;
+	struct timespec now;
+	uint32_t seq;
+
+	if (fr_map == NULL)
+		return;
+
+	clock_gettime(CLOCK_REALTIME, &now);
+	seq = fr_map->seq + 1;
+	if (seq == 0)
+		seq = 1;
+	rec = &fr_map->rec[seq & (FR_RECORDS - 1)];
+	rec->boot = fr_map->boot;
+	rec->tv_sec = now.tv_sec;
+	rec->tv_nsec = now.tv_nsec;
+	rec->type = type;
+	rec->state = state;
+	rec->value = value;
+	rec->seq = seq;
+	fr_map->seq = seq;
+}
+
+/*
+ * fr_flush
+ *
+ * @brief Writes the recorder back to storage. Called just before any power action.
+ */
+void fr_flush( void )
+{
+	char buf[FR_PMSG_RECORDS * 128];
+	const struct fr_record *rec;
+	unsigned int i;
+	int len = 0;
+	int pmsg;
+
+	if (fr_map == NULL)
+		return;
+
+	if (msync(fr_map, sizeof(struct fr_file), MS_SYNC) == -1)
+	{
+		perror("fr_flush msync");
+	}
+
+	/* Copy of the latest records to pstore, when available */
+	pmsg = open(FR_PMSG_DEVICE, O_WRONLY);
+	if (pmsg == -1)
+		return;
+	for (i = FR_PMSG_RECORDS; i > 0; i--)
+	{
+		rec = &fr_map->rec[(fr_map->seq - i + 1) & (FR_RECORDS - 1)];
+		if ((rec->seq == 0) || (rec->boot != fr_map->boot))
+			continue;
+		len += fr_format(rec, buf + len, sizeof(buf) - len);
+	}
+	if ((len > 0) && (write(pmsg, buf, len) == -1))
+	{
+		perror("fr_flush pmsg");
+	}
+	close(pmsg);
+}
+
+/*
+ * fr_close
+ *
+ * @brief Flushes and unmaps the recorder.
+ */
+void fr_close( void )
+{
+	if (fr_map == NULL)
+		return;
+	fr_flush();
+	munmap(fr_map, sizeof(struct fr_file));
+	fr_map = NULL;
+	close(fr_fd);
+	fr_fd = -1;
+}
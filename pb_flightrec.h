@@ -0,0 +1,91 @@
+/**********************************************************************************************************************
+*
+*   File:           pb_flightrec.h
+*
+*   Summary:        Reboot-surviving flight recorder of push-button decisions
+*
+*   Element:        IESv06
+*
+*   Platform:       Linux
+*
+*   Description:  Keeps the last FR_RECORDS press/decision/action records in a preallocated
+*                 memory-mapped file so the reason for a reboot survives it, with a copy of
+*                 the latest in pstore for when the file does not.
+*
+*******************************************************************************************************************/
+#ifndef PB_FLIGHTREC_H
+#define PB_FLIGHTREC_H
+
+#include <stdint.h>
+
+/*
+ * Defines
+ */
+#define FR_FILE             "/opt/monitors/pb_flightrec"
+#define FR_PMSG_DEVICE      "/dev/pmsg0"    /* pstore/ramoops user message area, if present */
+#define FR_PSTORE_DIR       "/sys/fs/pstore"
+#define FR_PSTORE_PMSG      "pmsg-ramoops-" /* its contents after the reboot */
+#define FR_RECORDS          64              /* must be a power of 2 */
+#define FR_MAGIC            0x50424652      /* 'PBFR' */
+#define FR_VERSION          1
+
+/*
+ * Enumuration - record type
+ */
+enum fr_type {
+	FR_BOOT,
+	FR_PRESS,
+	FR_RELEASE,
+	FR_DECISION,
+	FR_ACTION
+};
+
+/*
+ * Enumuration - decision taken on release
+ */
+enum fr_decision {
+	FR_DEC_NONE,
+	FR_DEC_REBOOT,
+	FR_DEC_FACTORY_RESET_NEXT,
+	FR_DEC_SHUTDOWN,
+	FR_DEC_CANCEL,
+	FR_DEC_FACTORY_RESET
+};
+
+/*
+ * One record - fixed size, written with plain stores into the mapping
+ */
+struct fr_record {
+	uint32_t seq;           /* 0 - slot never written */
+	uint32_t boot;          /* boot count the record belongs to */
+	int64_t  tv_sec;        /* CLOCK_REALTIME */
+	uint32_t tv_nsec;
+	uint8_t  type;          /* enum fr_type */
+	uint8_t  state;         /* enum pb_state */
+	uint16_t reserved;
+	uint32_t value;         /* press ms, decision or action */
+	uint32_t reserved2;
+};
+
+/*
+ * File layout - header followed by the record ring
+ */
+struct fr_file {
+	uint32_t magic;
+	uint32_t version;
+	uint32_t boot;
+	uint32_t seq;           /* last sequence number written */
+	struct fr_record rec[FR_RECORDS];
+};
+
+/*
+ * Globals
+ */
+extern const char *fr_pstore_dir;
+
+int  fr_open( const char *path );
+void fr_record( enum fr_type type, unsigned int state, unsigned long value );
+void fr_flush( void );
+void fr_close( void );
+
+#endif /* PB_FLIGHTREC_H */
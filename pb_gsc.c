@@ -0,0 +1,206 @@
+/**********************************************************************************************************************
+*
+*   File:           pb_gsc.c
+*
+*   Summary:        Gateworks System Controller access over a shared I2C bus
+*
+*   Element:        IESv06
+*
+*   Platform:       Linux (i2c-dev)
+*
+*   Description:  See pb_gsc.h. R10 is read and its push-button bits cleared in one message
+*                 set, by writing the complement of the mask: bits outside it are written 1
+*                 and stay as they are, so an interrupt latched between the read and the
+*                 clear - ours or another bus user's - is not lost, as it would be with a
+*                 read, then a write of the value read.
+*
+*******************************************************************************************************************/
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <linux/i2c.h>
+#include <linux/i2c-dev.h>
+
+#include "pb_gsc.h"
+#include "pb_latency.h"
+#include "pb_probes.h"
+
+/*
+ * Global - exported statistics
+ */
+struct gsc_stats gsc_stats = { .backoff_us = GSC_BACKOFF_MIN_US };
+
+/*
+ * Static
+ */
+static int gsc_fd = -1;
+static uint16_t gsc_addr;
+
+/*
+ **************  Functions  ****************
+ */
+
+/*
+ * gsc_contended
+ *
+ * @brief Is err a failure another bus user (or a busy GSC) can cause?
+ */
+static int gsc_contended( int err )
+{
+	return((err == EAGAIN) || (err == EBUSY) || (err == ETIMEDOUT) ||
+	       (err == ENXIO) || (err == EREMOTEIO) || (err == EIO));
+}
+
+/*
+ * gsc_transfer
+ *
+ * @brief Performs the message set, retrying with back-off while the bus is contended.
+ * @param reg - register, for tracing and messages
+ * @return 0, or -1 on failure (reported).
+ */
+static int gsc_transfer( unsigned int reg, struct i2c_msg *msgs, unsigned int nmsgs )
+{
+	struct i2c_rdwr_ioctl_data set = { .msgs = msgs, .nmsgs = nmsgs };
+	unsigned int retries = 0;
+	unsigned int delay_us = gsc_stats.backoff_us;
+	uint64_t start_ns = pb_time_ns(CLOCK_MONOTONIC);
+	int ret;
+
+	gsc_stats.transactions++;
+	while ((ret = ioctl(gsc_fd, I2C_RDWR, &set)) < 0)
+	{
+		if (!gsc_contended(errno) || (retries == GSC_RETRIES))
+		{
+			printf("GSC R%u: %s after %u retries\n", reg, strerror(errno), retries);
+			gsc_stats.failures++;
+			break;
+		}
+		/* Jitter, so two users backing off together do not retry together */
+		usleep(delay_us + (unsigned int)(pb_time_ns(CLOCK_MONOTONIC) % (delay_us / 2 + 1)));
+		delay_us = (delay_us * 2 > GSC_BACKOFF_MAX_US) ? GSC_BACKOFF_MAX_US : delay_us * 2;
+		retries++;
+	}
+	gsc_stats.retries += retries;
+
+	/* Start where contention is, ease off as it clears */
+	if (retries)
+		gsc_stats.backoff_us = (gsc_stats.backoff_us * 2 > GSC_BACKOFF_MAX_US) ?
+		                       GSC_BACKOFF_MAX_US : gsc_stats.backoff_us * 2;
+	else if (gsc_stats.backoff_us / 2 >= GSC_BACKOFF_MIN_US)
+		gsc_stats.backoff_us /= 2;
+
+	lat_record(&lat_i2c, (pb_time_ns(CLOCK_MONOTONIC) - start_ns) / 1000);
+	PB_PROBE3(i2c_xfer, reg, retries, start_ns);
+	return((ret < 0) ? -1 : 0);
+}
+
+/*
+ * gsc_open
+ *
+ * @brief Opens the I2C bus the GSC at addr is on.
+ * @return 0, or -1 on failure.
+ */
+int gsc_open( const char *bus, unsigned int addr )
+{
+	if ((gsc_fd = open(bus, O_RDWR | O_CLOEXEC)) == -1)
+	{
+		perror(bus);
+		return(-1);
+	}
+	gsc_addr = addr;
+	return(0);
+}
+
+/*
+ * gsc_read
+ *
+ * @brief Reads register reg - register write, repeated START, read.
+ * @return 0, or -1 on failure.
+ */
+int gsc_read( unsigned int reg, uint8_t *value )
+{
+	uint8_t ptr = reg;
+	struct i2c_msg msgs[2] = {
+		{ .addr = gsc_addr, .flags = 0,        .len = 1, .buf = &ptr },
+		{ .addr = gsc_addr, .flags = I2C_M_RD, .len = 1, .buf = value },
+	};
+
+	return(gsc_transfer(reg, msgs, 2));
+}
+
+/*
+ * gsc_disable_pb_reset
+ *
+ * @brief Clears PB_HARD_RESET in R0, leaving the other bits - no write if already clear.
+ * @return 0, or -1 on failure.
+ */
+int gsc_disable_pb_reset( void )
+{
+	uint8_t buf[2] = { GSC_CTRL_0, 0 };
+	struct i2c_msg msg = { .addr = gsc_addr, .flags = 0, .len = 2, .buf = buf };
+
+	if (gsc_read(GSC_CTRL_0, &buf[1]) < 0)
+		return(-1);
+	if (!(buf[1] & GSC_PB_HARD_RESET))
+		return(0);
+	buf[1] &= ~GSC_PB_HARD_RESET;
+	return(gsc_transfer(GSC_CTRL_0, &msg, 1));
+}
+
+/*
+ * gsc_irq_ack
+ *
+ * @brief Reads R10 and clears the bits in mask - one message set. Not for use while the
+ *        kernel gsc driver is bound: its interrupt handler owns R10, and a clear from here
+ *        can drop a press it has not yet seen.
+ * @param status - R10 before the clear, or NULL
+ * @return 0, or -1 on failure.
+ */
+int gsc_irq_ack( uint8_t mask, uint8_t *status )
+{
+	uint8_t ptr = GSC_IRQ_STATUS;
+	uint8_t value = 0;
+	uint8_t clear[2] = { GSC_IRQ_STATUS, (uint8_t)~mask };
+	struct i2c_msg msgs[3] = {
+		{ .addr = gsc_addr, .flags = 0,        .len = 1, .buf = &ptr },
+		{ .addr = gsc_addr, .flags = I2C_M_RD, .len = 1, .buf = &value },
+		{ .addr = gsc_addr, .flags = 0,        .len = 2, .buf = clear },
+	};
+
+	if (gsc_transfer(GSC_IRQ_STATUS, msgs, 3) < 0)
+		return(-1);
+	if (status)
+		*status = value;
+	return(0);
+}
+
+/*
+ * gsc_report
+ *
+ * @brief Prints the I2C statistics and transaction time histogram.
+ */
+void gsc_report( void )
+{
+	printf("GSC I2C: %lu transactions, %lu retries, %lu failures, back-off %u us\n",
+	       gsc_stats.transactions, gsc_stats.retries, gsc_stats.failures, gsc_stats.backoff_us);
+	lat_report(&lat_i2c);
+}
+
+/*
+ * gsc_close
+ *
+ * @brief Closes the bus. The statistics are kept.
+ */
+void gsc_close( void )
+{
+	if (gsc_fd != -1)
+	{
+		close(gsc_fd);
+		gsc_fd = -1;
+	}
+}
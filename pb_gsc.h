@@ -0,0 +1,67 @@
+/**********************************************************************************************************************
+*
+*   File:           pb_gsc.h
+*
+*   Summary:        Gateworks System Controller access over a shared I2C bus
+*
+*   Element:        IESv06
+*
+*   Platform:       Linux (i2c-dev)
+*
+*   Description:  The GSC at 0x20 on bus 0 is shared with the kernel hwmon/RTC drivers and the
+*                 telemetry daemon, so each access is one I2C_RDWR message set - one START,
+*                 repeated STARTs, one STOP - and the bus is held only for that. I2C_RDWR
+*                 addresses every message itself, so no I2C_SLAVE_FORCE ("i2cset -f") is
+*                 needed alongside the bound kernel driver.
+*
+*                 Register Details
+*                 GSC_CTRL_0           (R0)   PB_HARD_RESET (R0.0)
+*                 GSC_INTERRUPT_STATUS (R10)  IRQ_PB (R10.0), IRQ_GPIO_CHANGE (R10.4)
+*                                             a bit is cleared by writing it 0, 1 leaves it
+*
+*                 A contended transfer (arbitration lost, bus busy, time-out or NACK while
+*                 the GSC is busy) is retried after a back-off that doubles per retry. The
+*                 starting back-off adapts: doubled after a contended transaction, halved
+*                 after a clean one. Retries and failures are counted (gsc_report()) and
+*                 each transaction's time, back-off included, goes to the lat_i2c histogram.
+*
+*******************************************************************************************************************/
+#ifndef PB_GSC_H
+#define PB_GSC_H
+
+#include <stdint.h>
+
+/*
+ * Defines
+ */
+#define GSC_BUS             "/dev/i2c-0"
+#define GSC_ADDR            0x20
+#define GSC_CTRL_0          0x00
+#define GSC_PB_HARD_RESET   0x01
+#define GSC_IRQ_STATUS      0x0a
+#define GSC_IRQ_PB          0x01
+#define GSC_IRQ_GPIO_CHANGE 0x10
+#define GSC_RETRIES         8           /* per transaction, after the first attempt */
+#define GSC_BACKOFF_MIN_US  250
+#define GSC_BACKOFF_MAX_US  16000
+
+/*
+ * Statistics
+ */
+struct gsc_stats {
+	unsigned long transactions;
+	unsigned long retries;
+	unsigned long failures;
+	unsigned int  backoff_us;           /* starting back-off of the next retry */
+};
+
+extern struct gsc_stats gsc_stats;
+
+int  gsc_open( const char *bus, unsigned int addr );
+int  gsc_read( unsigned int reg, uint8_t *value );
+int  gsc_disable_pb_reset( void );
+int  gsc_irq_ack( uint8_t mask, uint8_t *status );
+void gsc_report( void );
+void gsc_close( void );
+
+#endif /* PB_GSC_H */
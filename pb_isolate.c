@@ -0,0 +1,295 @@
+/**********************************************************************************************************************
+*
+*   File:           pb_isolate.c
+*
+*   Summary:        Resource-isolated action children - cgroup v2 and I/O priority
+*
+*   Element:        IESv06
+*
+*   Platform:       Linux 4.5+ (cgroup v2)
+*
+*   Description:  See pb_isolate.h. The child moves itself into the action's cgroup (writing 0
+*                 to cgroup.procs) and sets its I/O priority between fork and exec, so nothing
+*                 it starts runs outside the limits.
+*
+*******************************************************************************************************************/
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <sys/wait.h>
+
+#include "pb_flightrec.h"
+#include "pb_isolate.h"
+
+/*
+ * Defines - ioprio_set(2), not in libc headers
+ */
+#define IOPRIO_CLASS_SHIFT      13
+#define IOPRIO_CLASS_RT         1
+#define IOPRIO_CLASS_BE         2
+#define IOPRIO_CLASS_IDLE       3
+#define IOPRIO_WHO_PROCESS      1
+#define IOPRIO_PRIO_VALUE(class, data)  (((class) << IOPRIO_CLASS_SHIFT) | (data))
+
+/*
+ * Static
+ */
+static char iso_dir[128];
+static int iso_on;
+static int iso_cgroup_ok;
+static int iso_prio = -1;
+
+/* cgroup per action, as enum fr_decision */
+static const char *iso_action_name[] = {
+	"check", "reboot", "factory-reset-next", "shutdown", "cancel", "factory-reset"
+};
+
+/*
+ **************  Functions  ****************
+ */
+
+/*
+ * iso_write
+ *
+ * @brief Writes value to the cgroup interface file dir/file.
+ * @return 0, or -1 on failure (reported).
+ */
+static int iso_write( const char *dir, const char *file, const char *value )
+{
+	char path[192];
+	int fd, ret = 0;
+
+	snprintf(path, sizeof(path), "%s/%s", dir, file);
+	fd = open(path, O_WRONLY | O_CLOEXEC);
+	if ((fd == -1) || (write(fd, value, strlen(value)) == -1))
+	{
+		printf("%s = %s: %s\n", path, value, strerror(errno));
+		ret = -1;
+	}
+	if (fd != -1)
+		close(fd);
+	return(ret);
+}
+
+/*
+ * iso_ioprio
+ *
+ * @brief Parses an I/O priority: idle, be:<0-7> or rt:<0-7>.
+ * @return ioprio_set() value, or -1 if invalid.
+ */
+int iso_ioprio( const char *value )
+{
+	char *end;
+	long level;
+	int class;
+
+	if (strcmp(value, "idle") == 0)
+		return(IOPRIO_PRIO_VALUE(IOPRIO_CLASS_IDLE, 0));
+	if (strncmp(value, "be:", 3) == 0)
+		class = IOPRIO_CLASS_BE;
+	else if (strncmp(value, "rt:", 3) == 0)
+		class = IOPRIO_CLASS_RT;
+	else
+		return(-1);
+	level = strtol(value + 3, &end, 10);
+	if ((end == value + 3) || (*end != '\0') || (level < 0) || (level > 7))
+		return(-1);
+	return(IOPRIO_PRIO_VALUE(class, (int)level));
+}
+
+/*
+ * iso_open
+ *
+ * @brief Creates root/pb_actions with the limits in spec (see pb_isolate.h) and turns
+ *        isolation on. The whole spec is checked before anything is written; a limit
+ *        that cannot be written removes pb_actions again. Without cgroup v2, or if
+ *        pb_actions cannot be created, only the I/O priority is applied.
+ * @param root - cgroup v2 mount, normally ISO_CGROUP_ROOT
+ * @return 0, or -1 if spec is invalid or cannot be applied (isolation stays off).
+ */
+int iso_open( const char *root, const char *spec )
+{
+	char buf[ISO_SPEC_LEN];
+	char path[192];
+	char *key[ISO_SPEC_ITEMS], *value[ISO_SPEC_ITEMS];
+	char *item, *eq, *save;
+	unsigned int i, n = 0;
+	int prio = -1;
+
+	iso_on = 0;
+	if (strlen(spec) >= sizeof(buf))
+	{
+		printf("Isolation: spec too long\n");
+		return(-1);
+	}
+	strcpy(buf, spec);
+
+	/* Parse and check it all first - a bad spec leaves no cgroup behind */
+	for (item = strtok_r(buf, ",", &save); item != NULL; item = strtok_r(NULL, ",", &save))
+	{
+		if ((eq = strchr(item, '=')) == NULL)
+		{
+			printf("Isolation: %s: expected key=value\n", item);
+			return(-1);
+		}
+		*eq++ = '\0';
+		if (strcmp(item, "ioprio") == 0)
+		{
+			if ((prio = iso_ioprio(eq)) < 0)
+			{
+				printf("Isolation: ioprio %s: expected idle, be:<0-7> or rt:<0-7>\n", eq);
+				return(-1);
+			}
+		}
+		else if (strchr(item, '.') == NULL)
+		{
+			printf("Isolation: %s: not a cgroup file or ioprio\n", item);
+			return(-1);
+		}
+		else if (n == ISO_SPEC_ITEMS)
+		{
+			printf("Isolation: more than %d cgroup files\n", ISO_SPEC_ITEMS);
+			return(-1);
+		}
+		else
+		{
+			key[n] = item;
+			value[n++] = eq;
+		}
+	}
+
+	snprintf(iso_dir, sizeof(iso_dir), "%s/%s", root, ISO_CGROUP);
+	/* Only on a cgroup v2 hierarchy - not a plain directory on a v1 system's tmpfs */
+	snprintf(path, sizeof(path), "%s/cgroup.controllers", root);
+	if (access(path, F_OK) == -1)
+	{
+		printf("%s: not cgroup v2 - actions not in a cgroup\n", root);
+		iso_cgroup_ok = 0;
+	}
+	else
+	{
+		/* Controllers must be enabled above pb_actions for its files to exist */
+		iso_write(root, "cgroup.subtree_control", ISO_CONTROLLERS);
+		iso_cgroup_ok = ((mkdir(iso_dir, 0755) == 0) || (errno == EEXIST));
+		if (!iso_cgroup_ok)
+			printf("%s: %s - actions not in a cgroup\n", iso_dir, strerror(errno));
+	}
+	if (iso_cgroup_ok)
+	{
+		for (i = 0; i < n; i++)
+		{
+			if (iso_write(iso_dir, key[i], value[i]) == -1)
+			{
+				rmdir(iso_dir);
+				iso_cgroup_ok = 0;
+				return(-1);
+			}
+		}
+		/* Per-action children get the controllers too, for accounting */
+		iso_write(iso_dir, "cgroup.subtree_control", ISO_CONTROLLERS);
+	}
+	iso_prio = prio;
+	iso_on = 1;
+	printf("Action isolation: %s (%s)\n", iso_dir, spec);
+	return(0);
+}
+
+/*
+ * iso_enter
+ *
+ * @brief Moves the calling process (a forked child) into action's cgroup, if isolation
+ *        is on, and sets its I/O priority. Failures are reported, not returned.
+ * @param action - enum fr_decision, selects the cgroup
+ * @param ioprio - iso_ioprio() value, or -1 for the configured one
+ */
+void iso_enter( unsigned int action, int ioprio )
+{
+	char dir[192];
+
+	if (iso_on && iso_cgroup_ok)
+	{
+		snprintf(dir, sizeof(dir), "%s/%s", iso_dir,
+		         (action <= FR_DEC_FACTORY_RESET) ? iso_action_name[action] : "other");
+		if ((mkdir(dir, 0755) == -1) && (errno != EEXIST))
+			printf("%s: %s\n", dir, strerror(errno));
+		else
+			iso_write(dir, "cgroup.procs", "0");
+	}
+	if (ioprio < 0)
+		ioprio = iso_on ? iso_prio : -1;
+	if ((ioprio >= 0) && (syscall(SYS_ioprio_set, IOPRIO_WHO_PROCESS, 0, ioprio) == -1))
+		perror("ioprio_set");
+	fflush(stdout);
+}
+
+/*
+ * iso_system
+ *
+ * @brief Runs cmd with /bin/sh like system(), isolated if iso_open() was called.
+ * @param action - enum fr_decision, selects the cgroup
+ * @return status as system().
+ */
+int iso_system( unsigned int action, const char *cmd )
+{
+	int status;
+	pid_t pid;
+
+	if (!iso_on)
+		return(system(cmd));
+
+	/* Do not let the child flush our buffered output a second time */
+	fflush(NULL);
+	pid = fork();
+	if (pid == -1)
+	{
+		perror("fork");
+		return(-1);
+	}
+	if (pid == 0)
+	{
+		/* Child - failures are reported, the action still runs */
+		iso_enter(action, -1);
+		execl("/bin/sh", "sh", "-c", cmd, (char *)NULL);
+		_exit(127);
+	}
+	while (waitpid(pid, &status, 0) == -1)
+	{
+		if (errno != EINTR)
+		{
+			perror("waitpid");
+			return(-1);
+		}
+	}
+	return(status);
+}
+
+/*
+ * iso_close
+ *
+ * @brief Turns isolation off and removes the per-action cgroups that are empty.
+ */
+void iso_close( void )
+{
+	char dir[192];
+	unsigned int i;
+
+	if (!iso_on)
+		return;
+	iso_on = 0;
+	if (!iso_cgroup_ok)
+		return;
+	for (i = 0; i <= FR_DEC_FACTORY_RESET; i++)
+	{
+		snprintf(dir, sizeof(dir), "%s/%s", iso_dir, iso_action_name[i]);
+		rmdir(dir);
+	}
+	snprintf(dir, sizeof(dir), "%s/other", iso_dir);
+	rmdir(dir);
+	rmdir(iso_dir);
+}
@@ -0,0 +1,45 @@
+/**********************************************************************************************************************
+*
+*   File:           pb_isolate.h
+*
+*   Summary:        Resource-isolated action children - cgroup v2 and I/O priority
+*
+*   Element:        IESv06
+*
+*   Platform:       Linux 4.5+ (cgroup v2)
+*
+*   Description:  With isolation on, the exec plugin runs each external action command in its
+*                 own cgroup, <root>/pb_actions/<action>, and at the configured I/O priority,
+*                 instead of with system(). pb_actions carries the weights and limits, so a
+*                 factory reset competes with the rest of the system as one low-weight group
+*                 and cannot starve pb_monitor or the data plane:
+*
+*                   cpu.weight=10,io.weight=10,memory.high=128M,ioprio=idle
+*
+*                 Keys containing a '.' are cgroup interface files written as given; ioprio
+*                 is idle, be:<0-7> or rt:<0-7>. A spec that is invalid, or whose limits
+*                 cannot be written, leaves isolation off and no pb_actions behind. Failures
+*                 while an action starts never stop it - it runs with whatever isolation
+*                 could be applied.
+*
+*******************************************************************************************************************/
+#ifndef PB_ISOLATE_H
+#define PB_ISOLATE_H
+
+/*
+ * Defines
+ */
+#define ISO_CGROUP_ROOT     "/sys/fs/cgroup"             /* unified hierarchy */
+#define ISO_CGROUP          "pb_actions"
+#define ISO_CONTROLLERS     "+cpu +io +memory"
+#define ISO_DEFAULT_SPEC    "cpu.weight=10,io.weight=10,ioprio=be:7"
+#define ISO_SPEC_LEN        256
+#define ISO_SPEC_ITEMS      16                           /* cgroup files in a spec */
+
+int  iso_ioprio( const char *value );
+int  iso_open( const char *root, const char *spec );
+void iso_enter( unsigned int action, int ioprio );
+int  iso_system( unsigned int action, const char *cmd );
+void iso_close( void );
+
+#endif /* PB_ISOLATE_H */
@@ -0,0 +1,110 @@
+/**********************************************************************************************************************
+*
+*   File:           pb_latency.c
+*
+*   Summary:        Wake-latency histograms for the push-button monitor
+*
+*   Element:        IESv06
+*
+*   Platform:       Linux
+*
+*   Description:  lat_wake  - kernel input_event timestamp to user space handling it.
+*                 lat_timer - how late each timer expiry ran after its deadline.
+*                 lat_loop  - event-loop iteration lag (pb_liveness.c); an alert is a stall.
+*                 Recording is a few integer operations, cheap enough for every event and
+*                 every deadline libpbmon handles. Alerts are rate limited to one message per
+*                 LAT_ALERT_PERIOD_S; lat_report() prints the histogram on request.
+*
+*******************************************************************************************************************/
+
+#include <stdio.h>
+#include <time.h>
+
+#include "pb_latency.h"
+
+/*
+ * Global - histograms, alert thresholds set from the command line
+ */
+struct lat_hist lat_wake  = { .name = "event wake", .alert_us = LAT_WAKE_ALERT_US };
+struct lat_hist lat_timer = { .name = "timer overshoot", .alert_us = LAT_TIMER_ALERT_US };
+struct lat_hist lat_loop  = { .name = "loop lag", .alert_us = LAT_LOOP_ALERT_US };
+struct lat_hist lat_i2c   = { .name = "i2c transaction", .alert_us = LAT_I2C_ALERT_US };
+
+/*
+ **************  Functions  ****************
+ */
+
+/*
+ * lat_bucket
+ *
+ * @brief Returns the log2 bucket for a sample in microseconds.
+ */
+static unsigned int lat_bucket( uint64_t us )
+{
+	unsigned int n = 0;
+
+	while ((us > 0) && (n < LAT_BUCKETS - 1))
+	{
+		us >>= 1;
+		n++;
+	}
+	return(n);
+}
+
+/*
+ * lat_record
+ *
+ * @brief Adds a sample to hist and reports it if over the alert threshold.
+ * @param hist - histogram
+ * @param us   - latency in microseconds
+ */
+void lat_record( struct lat_hist *hist, uint64_t us )
+{
+	struct timespec now;
+
+	hist->count++;
+	hist->sum_us += us;
+	hist->buckets[lat_bucket(us)]++;
+	if (us > hist->max_us)
+		hist->max_us = us;
+
+	if ((hist->alert_us == 0) || (us < hist->alert_us))
+		return;
+
+	hist->alerts++;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	if ((hist->last_alert_s != 0) && (now.tv_sec - hist->last_alert_s < LAT_ALERT_PERIOD_S))
+	{
+		hist->suppressed++;
+		return;
+	}
+	printf("pb_monitor: %s %llu us over alert %llu us (%lu more suppressed)\n",
+	       hist->name, (unsigned long long)us, (unsigned long long)hist->alert_us,
+	       hist->suppressed);
+	hist->suppressed = 0;
+	hist->last_alert_s = now.tv_sec;
+}
+
+/*
+ * lat_report
+ *
+ * @brief Prints hist - count, mean, max, alerts and the non-empty buckets.
+ */
+void lat_report( const struct lat_hist *hist )
+{
+	unsigned int n;
+
+	printf("%s: count=%lu mean=%lluus max=%lluus alerts=%lu (alert at %lluus)\n",
+	       hist->name, hist->count,
+	       (unsigned long long)(hist->count ? hist->sum_us / hist->count : 0),
+	       (unsigned long long)hist->max_us, hist->alerts,
+	       (unsigned long long)hist->alert_us);
+	for (n = 0; n < LAT_BUCKETS; n++)
+	{
+		if (hist->buckets[n] == 0)
+			continue;
+		printf("  [%8lluus, %8lluus) %lu\n",
+		       (unsigned long long)(n ? 1ULL << (n - 1) : 0),
+		       (unsigned long long)(1ULL << n), hist->buckets[n]);
+	}
+}
@@ -0,0 +1,56 @@
+/**********************************************************************************************************************
+*
+*   File:           pb_latency.h
+*
+*   Summary:        Wake-latency histograms for the push-button monitor
+*
+*   Element:        IESv06
+*
+*   Platform:       Linux
+*
+*   Description:  Log2 histograms of the delay between a kernel input_event timestamp and
+*                 pb_monitor handling it, of the overshoot of each timer deadline, and of
+*                 each GSC I2C transaction.
+*                 A sample at or over the alert threshold is reported, so a starved monitor
+*                 shows up in the log.
+*
+*******************************************************************************************************************/
+#ifndef PB_LATENCY_H
+#define PB_LATENCY_H
+
+#include <stdint.h>
+
+/*
+ * Defines
+ */
+#define LAT_BUCKETS             24          /* 1us .. 8s in powers of 2 */
+#define LAT_WAKE_ALERT_US       20000       /* default event wake alert */
+#define LAT_TIMER_ALERT_US      50000       /* default timer overshoot alert */
+#define LAT_LOOP_ALERT_US       1000000     /* default event-loop stall */
+#define LAT_I2C_ALERT_US        10000       /* GSC I2C transaction, back-off included */
+#define LAT_ALERT_PERIOD_S      60          /* at most one alert message per period */
+
+/*
+ * Histogram - bucket n counts samples in [2^(n-1), 2^n) us, bucket 0 is < 1us
+ */
+struct lat_hist {
+	const char    *name;
+	uint64_t      alert_us;
+	unsigned long count;
+	unsigned long alerts;
+	unsigned long suppressed;
+	uint64_t      max_us;
+	uint64_t      sum_us;
+	int64_t       last_alert_s;
+	unsigned long buckets[LAT_BUCKETS];
+};
+
+extern struct lat_hist lat_wake;
+extern struct lat_hist lat_timer;
+extern struct lat_hist lat_loop;
+extern struct lat_hist lat_i2c;
+
+void lat_record( struct lat_hist *hist, uint64_t us );
+void lat_report( const struct lat_hist *hist );
+
+#endif /* PB_LATENCY_H */
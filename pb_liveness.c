@@ -0,0 +1,208 @@
+/**********************************************************************************************************************
+*
+*   File:           pb_liveness.c
+*
+*   Summary:        Event-loop stall detector and hardware watchdog
+*
+*   Element:        IESv06
+*
+*   Platform:       Linux
+*
+*   Description:  The main loop calls live_wake() when select returns and live_idle() just
+*                 before it blocks again. The iteration lag is the larger of
+*                 - the time spent handling the wake (e.g. blocked in a system() call), and
+*                 - how far the wake came after the longest expected idle (the select
+*                   time-out), which catches a starved process or time lost in the
+*                   libpbmon dispatch (deadline callbacks) before the loop got control.
+*                 Lag goes into the lat_loop histogram; a lag over its alert threshold is a
+*                 stall and is reported.
+*
+*                 With a watchdog device the watchdog is only petted at the end of an
+*                 iteration without a stall. If the loop wedges or pb_monitor exits
+*                 without live_suspend(), the watchdog resets the board.
+*                 live_suspend() disarms the watchdog (magic close) before a deliberate
+*                 power action. Any other action blocking the loop keeps it armed:
+*                 live_extend() raises the time-out to a bound for the action and
+*                 live_restore() sets it back, so a hung action still resets the board.
+*
+*******************************************************************************************************************/
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <linux/watchdog.h>
+
+#include "pb_latency.h"
+#include "pb_liveness.h"
+#include "pb_probes.h"
+
+/*
+ * Static
+ */
+static const char *live_wdt_device = NULL;
+static int live_wdt_timeout = LIVE_WDT_TIMEOUT;
+static int live_wdt_fd = -1;
+static uint64_t live_max_idle_ns;
+static uint64_t live_idle_ns;       /* loop last blocked */
+static uint64_t live_wake_ns;       /* loop last woke */
+
+/*
+ **************  Functions  ****************
+ */
+
+/*
+ * live_arm
+ *
+ * @brief Opens the watchdog device, which starts it, and sets its time-out.
+ * @return 0 on success, -1 on failure.
+ */
+static int live_arm( void )
+{
+	live_wdt_fd = open(live_wdt_device, O_WRONLY);
+	if (live_wdt_fd == -1)
+	{
+		perror("watchdog open");
+		return(-1);
+	}
+	if (ioctl(live_wdt_fd, WDIOC_SETTIMEOUT, &live_wdt_timeout) == -1)
+	{
+		perror("watchdog timeout");
+	}
+	printf("Watchdog %s armed, timeout %d seconds\n", live_wdt_device, live_wdt_timeout);
+	return(0);
+}
+
+/*
+ * live_open
+ *
+ * @brief Starts loop lag measurement and, if wdt_device is set, the hardware watchdog.
+ * @param wdt_device  - watchdog device (e.g. /dev/watchdog) or NULL for none
+ * @param wdt_timeout - watchdog time-out, seconds
+ * @param max_idle    - longest the loop blocks when nothing happens, seconds
+ * @return 0 on success, -1 if the watchdog could not be opened.
+ */
+int live_open( const char *wdt_device, unsigned int wdt_timeout, unsigned int max_idle )
+{
+	live_max_idle_ns = (uint64_t)max_idle * 1000000000ULL;
+	live_idle_ns = pb_time_ns(CLOCK_MONOTONIC);
+	live_wake_ns = live_idle_ns;
+
+	if (wdt_device == NULL)
+		return(0);
+	live_wdt_device = wdt_device;
+	live_wdt_timeout = wdt_timeout;
+	return(live_arm());
+}
+
+/*
+ * live_wake
+ *
+ * @brief Loop has woken from select.
+ */
+void live_wake( void )
+{
+	live_wake_ns = pb_time_ns(CLOCK_MONOTONIC);
+}
+
+/*
+ * live_idle
+ *
+ * @brief Loop is about to block. Records the iteration lag and pets the watchdog
+ *        if there was no stall.
+ */
+void live_idle( void )
+{
+	uint64_t now = pb_time_ns(CLOCK_MONOTONIC);
+	uint64_t lag = now - live_wake_ns;
+
+	if ((live_wake_ns - live_idle_ns > live_max_idle_ns) &&
+	    (live_wake_ns - live_idle_ns - live_max_idle_ns > lag))
+	{
+		lag = live_wake_ns - live_idle_ns - live_max_idle_ns;
+	}
+	live_idle_ns = now;
+
+	lat_record(&lat_loop, lag / 1000);
+	if (lag / 1000 >= lat_loop.alert_us)
+	{
+		/* Stall - let the watchdog decide if the loop is not back in time */
+		return;
+	}
+	if (live_wdt_fd != -1)
+	{
+		ioctl(live_wdt_fd, WDIOC_KEEPALIVE, 0);
+	}
+}
+
+/*
+ * live_suspend
+ *
+ * @brief Disarms the watchdog before a deliberate power action or long operation.
+ */
+void live_suspend( void )
+{
+	if (live_wdt_fd == -1)
+		return;
+	/* Magic close - stops the watchdog unless the driver is 'nowayout' */
+	if (write(live_wdt_fd, "V", 1) == -1)
+	{
+		perror("watchdog magic close");
+	}
+	close(live_wdt_fd);
+	live_wdt_fd = -1;
+}
+
+/*
+ * live_settimeout
+ *
+ * @brief Sets the watchdog time-out, halving a request the driver refuses down to
+ *        the normal time-out, and pets the watchdog.
+ * @return time-out set, seconds.
+ */
+static int live_settimeout( int timeout )
+{
+	while ((ioctl(live_wdt_fd, WDIOC_SETTIMEOUT, &timeout) == -1) &&
+	       (errno == EINVAL) && (timeout / 2 >= live_wdt_timeout))
+	{
+		timeout /= 2;
+	}
+	ioctl(live_wdt_fd, WDIOC_KEEPALIVE, 0);
+	return(timeout);
+}
+
+/*
+ * live_extend
+ *
+ * @brief Raises the watchdog time-out for an action that blocks the loop for up to
+ *        seconds. The watchdog stays armed.
+ */
+void live_extend( unsigned int seconds )
+{
+	int timeout;
+
+	if (live_wdt_fd == -1)
+		return;
+	timeout = live_settimeout(seconds);
+	if (timeout < (int)seconds)
+	{
+		printf("Watchdog time-out %d seconds, %u requested\n", timeout, seconds);
+	}
+}
+
+/*
+ * live_restore
+ *
+ * @brief Sets the normal watchdog time-out back after live_extend() and restarts
+ *        lag measurement, so the action is not counted as a stall.
+ */
+void live_restore( void )
+{
+	live_idle_ns = pb_time_ns(CLOCK_MONOTONIC);
+	live_wake_ns = live_idle_ns;
+	if (live_wdt_fd == -1)
+		return;
+	live_settimeout(live_wdt_timeout);
+}
@@ -0,0 +1,33 @@
+/**********************************************************************************************************************
+*
+*   File:           pb_liveness.h
+*
+*   Summary:        Event-loop stall detector and hardware watchdog
+*
+*   Element:        IESv06
+*
+*   Platform:       Linux
+*
+*   Description:  Measures the lag of each main loop iteration and pets the hardware
+*                 watchdog only while the loop is responsive, so a wedged monitor becomes
+*                 a hardware reset rather than a dead power button.
+*
+*******************************************************************************************************************/
+#ifndef PB_LIVENESS_H
+#define PB_LIVENESS_H
+
+/*
+ * Defines
+ */
+#define LIVE_WDT_TIMEOUT    30      /* seconds - must exceed the loop's select time-out */
+#define LIVE_ACTION_TIMEOUT 120     /* seconds - an action command blocking the loop */
+#define LIVE_RESET_TIMEOUT  600     /* seconds - the factory reset script */
+
+int  live_open( const char *wdt_device, unsigned int wdt_timeout, unsigned int max_idle );
+void live_wake( void );
+void live_idle( void );
+void live_suspend( void );
+void live_extend( unsigned int seconds );
+void live_restore( void );
+
+#endif /* PB_LIVENESS_H */
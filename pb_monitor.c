@@ -14,6 +14,7 @@
 *                 AT START-UP
 *                 - Checks file (/opt/monior/fc_set) on start-up to see if pb pressed while in use.
 *                 - Yes - LED Flashes red while factory reset occurs.
+*                   (With -R the reset is a snapshot swap and a reboot, see below.)
 *                 - No  - A 10 second period where LED is solid red, allows factory reset
 *                   If pushed, factory-reset occurs. Otherwise allows period to call it.
 *
@@ -30,465 +31,232 @@
 *                 - Press push-button for 15+ seconds, LED flashes green, and cancels press.
 *
 *   Operation: uses /sys/class/input/event0 select (blocking) and read with
-*              signal timer and measurement of pb press release period.
+*              a timer and measurement of pb press release period. The device,
+*              timing and classification are in libpbmon (pbmon.c, pb_press.c);
+*              this file is the stand-alone main() on top of it.
+*              Timer1 and the LED threshold of a held press are deadlines in one
+*              scheduler on a single timerfd (pb_deadline.h), so a threshold's LED
+*              change is on time rather than at the next Timer1 interval.
+*              Actions and the LED driver can be in-process plugins (pb_plugin.h,
+*              plugins/), loaded with -P; external commands remain the fallback.
+*              Press, release, decision and action records are kept in a flight
+*              recorder (pb_flightrec.c) and flushed before any power action, so
+*              the reason for a reboot is reported on the next start-up.
+*              Static tracepoints (pb_probes.h) mark event read, press start,
+*              threshold crossing, release, LED write and action spawn/exit.
+*              Wake latency (kernel event time to handling) and deadline overshoot are
+*              kept in histograms (pb_latency.c); SIGUSR1 prints them, with the GSC I2C
+*              retry counts and transaction times (pb_gsc.h).
+*              Main loop stalls are detected (pb_liveness.c) and, with -W, the hardware
+*              watchdog is only petted while the loop is responsive.
+*              With -U libpbmon uses io_uring: a read re-armed with a linked timeout
+*              for the earliest deadline, LED plugin writes batched into the same submission.
+*              With -C a local management agent can inject virtual presses or request
+*              an action over a Unix socket (pb_command.h); -G also lets a group in.
+*              With -A external action commands run in their own cgroup with the given
+*              weights/limits and I/O priority (pb_isolate.h; -A default for the defaults).
+*              With -R a factory reset swaps the overlay's upper directory for an empty
+*              one and reboots (pb_reset.h); the old data is erased in the background
+*              after that boot, the LED solid green until done. 5-10s presses then
+*              swap straight away rather than writing the start-up file.
 *
-*   Compile :    gcc -lrt pb_monitor.c -o pb_monitor
-*                Run     :   ./test_gpio2 /dev/input/event0
+*   Compile :    gcc pb_monitor.c pbmon.c pb_press.c pb_plugin.c pb_flightrec.c pb_latency.c pb_liveness.c \
+*                    pb_uring.c pb_command.c pb_isolate.c pb_reset.c pb_deadline.c pb_gsc.c -lrt -ldl -o pb_monitor
+*                Host tests / benchmarks: make -f platform_program.mk test bench
+*                Run     :   ./pb_monitor [-w wake_alert_us] [-t timer_alert_us] [-s stall_ms]
+*                                         [-W /dev/watchdog] [-P plugin.so[:arg]]... [-U]
+*                                         [-C /run/pb_monitor.sock [-G gid]]
+*                                         [-A cpu.weight=10,io.weight=10,ioprio=be:7] [-R /data]
+*                                         /dev/input/event0
 *
 *   NOTE: REPLACED I2C POLL version pb_monitor.sh
 *
 *******************************************************************************************************************/
 
-#include <errno.h>
-#include <fcntl.h>
-#include <linux/input.h>
 #include <stdio.h>
 #include <stdlib.h>
-#include <time.h>
+#include <string.h>
 #include <unistd.h>
 #include <signal.h>
-#include <string.h>
-#include <stdbool.h>  /* true, false */
-#include <sys/stat.h>
-
-/*
- * Defines
- */
-#define TIMER1_EXPIRE   10     /* seconds */
-#define TIMER1_INTERVAL 2
-#define FACTORY_RESET_FILE  "/opt/monitors/fc-set"
+#include <sys/select.h>
 
-/*
- * Enumuration
- */
-enum led_state {
-	LED_OFF,
-	LED_GREEN,
-	LED_RED,
-	LED_FLASH_GREEN,
-	LED_FLASH_RED
-};
+#include "pb_command.h"
+#include "pb_gsc.h"
+#include "pb_isolate.h"
+#include "pb_latency.h"
+#include "pb_liveness.h"
+#include "pb_plugin.h"
+#include "pb_reset.h"
+#include "pbmon.h"
 
 /*
- * Global - Enum type declaration
+ * Defines
  */
-enum pb_state {
-	PB_STATE_START,
-	PB_STATE_INUSE
-} state;
+#define LOOP_TIMEOUT    3      /* seconds - select time-out */
 
 /*
- * Global Strings - Bash script system calls
+ * Global - requests from signal handlers
  */
-char str_sys_call_i2c_reset[]  = "i2cset -f -y 0 0x20 0 0";
-char str_sys_call_opt_dir[]  = "mkdir -p /opt/monitors/";
-char str_sys_call_check_factory_reset[]  = "/usr/local/bin/check-factory-reset.sh ";
-char str_sys_call_reboot[] = "reboot";
-char str_sys_call_shutdown[] = "shutdown -h now";
-char str_sys_call_led[][16] = {
-        {"./set_led.sh 0"},
-        {"./set_led.sh 1"},
-        {"./set_led.sh 2"},
-        {"./set_led.sh 3"},
-        {"./set_led.sh 4"}
-};
+volatile sig_atomic_t report_request;
+volatile sig_atomic_t exit_request;
 
 /*
  **************  Functions  ****************
  */
 
 /*
- * pb_initialise
- *
- * @brief Disables I2C Hardware reset and creates monitor directory.
- * @return void.
- */
-void pb_initialise( void )
-{
-	/* Disable pb */
-	system(str_sys_call_i2c_reset);
-	/* Make Directory if not present */
-	system(str_sys_call_opt_dir);
-}
-
-/*
- * timer_handler
- *
- * @brief Signal handler on timer expire
- * @param sig -
- * @param *si -
- * @param *uc -
- * @return void.
- */
-static void timer_handler(int sig, siginfo_t *si, void *uc)
-{
-    /* On First entry Change state */
-	if (state == PB_STATE_START)
-	{
-	    printf("Signal %d - Changes pb mode to in-use\n", sig);
-	    state = PB_STATE_INUSE;
-	    system(str_sys_call_led[LED_FLASH_GREEN]);
-	    /* Must call check-factory-reset.sh wthout causing facory reset */
-	    strcat (str_sys_call_check_factory_reset, "0");
-   	    /* Call check-factory-reset.sh to perform a factory reset */
-   	    system(str_sys_call_check_factory_reset);
-	}
-}
-
-/*
- * make_timer
- *
- * @brief Creates timer for first period and constant interval timeouts
- *        Calls Signal handler on timer expire. The 'select' does not time-out
- *        The initial timer period allows switch between START-UP mode and INUSE mode
- *        The subsequent interval timer allows LED to be driven for reboot(flash green),
- *        factory reset on reboot(solid red) and shutdown(flash red).
- */
-int make_timer( char *name, timer_t *timerID, int expireS, int intervalS )
-{
-	    struct sigevent         te;
-	    struct itimerspec       its;
-	    struct sigaction        sa;
-	    int                     sigNo = SIGRTMIN;
-
-	    /* Set up signal handler. */
-	    sa.sa_flags = SA_SIGINFO;
-	    sa.sa_sigaction = timer_handler;
-	    sigemptyset(&sa.sa_mask);
-	    if (sigaction(sigNo, &sa, NULL) == -1)
-	    {
-            perror("sigaction");
-	    	printf( "Failed to setup signal handler\n");
-	        return(-1);
-	    }
-	    /* Set and enable alarm */
-	    te.sigev_notify = SIGEV_SIGNAL;
-	    te.sigev_signo = sigNo;
-	    te.sigev_value.sival_ptr = timerID;
-	    if ((timer_create(CLOCK_REALTIME, &te, timerID)) == -1)
-	    {
-            perror("timer_create");
-            printf( "Failed to create timer\n");
-	        return(-1);
-	    }
-
-	    /* repeat */
-	    its.it_interval.tv_sec = intervalS;  //intervalMS;
-	    its.it_interval.tv_nsec = 0;
-	    /* initial */
-	    its.it_value.tv_sec = expireS;
-	    its.it_value.tv_nsec = 0;
-
-	    /* Start Timer */
-	    if ((timer_settime(*timerID, 0, &its, NULL)) !=0)
-	    {
-	    	perror("timer_start");
-	        printf( "timer_settime failed:%d -(%s)\n", errno, strerror(errno));
-	    }
-	    return(0);
-}
-
-/*
- * timespec_diff
- *
- * @brief Called from test_time to calculates pb press time and returns in result.
- */
-void timespec_diff(const struct timespec *start, const struct timespec *stop,
-                   struct timespec *result)
-{
-    if ((stop->tv_nsec - start->tv_nsec) < 0)
-    {
-        result->tv_sec = stop->tv_sec - start->tv_sec - 1;
-        result->tv_nsec = stop->tv_nsec - start->tv_nsec + 1000000000UL;
-    }
-    else
-    {
-        result->tv_sec = stop->tv_sec - start->tv_sec;
-        result->tv_nsec = stop->tv_nsec - start->tv_nsec;
-    }
-}
-
-/*
- * test_time
- *
- * @brief If start time is set, raed curent time and call function to calculate time.
- */
-double test_time (const struct timespec *start, struct timespec *stop, struct timespec *duration)
-{
-	/* invalid if no start time set */
-	if (( start->tv_sec > 0 ) || (start->tv_nsec > 0 ))
-	{
-		/* current time */
-        if((clock_gettime( CLOCK_REALTIME, stop)) == -1)
-        {
-            perror("clock gettime");
-            return (0);
-	    }
-	    timespec_diff ( start, stop, duration);
-        return ((double)duration->tv_sec + ((double)duration->tv_nsec /1000000000));
-	}
-	return (0);
-}
-
-/*
- * process_time
- *
- * @brief Process the time so far to determine LED changes.
- *        Note accurate to time + timer interval period
- */
-void process_time( unsigned long seconds)
-{
-    if (state == PB_STATE_INUSE)
-    {
-    	if (seconds >= 15)
-    	{
-    	    // return to heartbeat
-    	    system(str_sys_call_led[LED_FLASH_GREEN]);
-    	}
-        else if (seconds >= 10)
-        {
-    	    // Flash red - release for shutdown
-    	    system(str_sys_call_led[LED_FLASH_RED]);
-        }
-    	else if (seconds >= 5)
-    	{
-			// Solid red - release for factory reset
-    	    system(str_sys_call_led[LED_RED]);
-        }
-    }
-}
-
-/*
- * process_end_time
+ * report_handler
  *
- * @brief Process the final time (accurate) to determine which button functionality to implement
- *        reboot; factory reset (on next power-up); shutdown; cancel
+ * @brief SIGUSR1 handler - requests the main loop to print the latency histograms.
  */
-void process_end_time( unsigned long seconds)
+static void report_handler(int sig)
 {
-	FILE *file_ptr;
-	if (seconds >= 15)
-	{
-	   	printf("Long Push-Button Press (15+sec) - cancelled\n");
-	}
-	else if (seconds >= 10)
-    {
-    	printf("Long Push-Button Press (10+sec) - shutdown\n");
-    	system(str_sys_call_shutdown);
-    }
-    else if (seconds >= 5)
-    {
-    	printf("Long Push-Button Press (5+sec) - Enter factory reset on next reboot\n");
-        /* Create File to be checked on start-up */
-    	file_ptr = fopen(FACTORY_RESET_FILE, "w");
-    	fclose(file_ptr);
-    }
-    else  /* less than 5 seconds */
-    {
-    	if (state == PB_STATE_INUSE)
-    	{
-    		/* REBOOT */
-    		printf("Short Push-ButtonPress (less 5sec ) - reboot\n");
-    		system(str_sys_call_reboot);
-    	}
-    	else
-    	{
-    		/* STARTUP - Factory reset */
-    		printf("Factory Reset\n");
-    		strcat (str_sys_call_check_factory_reset, "1");
-    	    /* Call check-factory-reset.sh to perform a factory reset */
-    	    system(str_sys_call_check_factory_reset);
-    	    /* set mode to IN-USE */
-       		state = PB_STATE_INUSE;
-       		// return to heartbeat
-    	    system(str_sys_call_led[LED_FLASH_GREEN]);
-    	}
-    }
+	report_request = 1;
 }
 
 /*
- * check_inuse_factory_reset
+ * exit_handler
  *
- * @brief  Is there a file indicating factory-reset was requested IN-USE
- *         in which case perform factory-reset, otherwise STARTUP by setting
- *         LED to solid red, and wait time to 10 seconds (allow pb press to
- *         immediate factory reset).
+ * @brief SIGTERM/SIGINT handler - requests the main loop to exit cleanly.
  */
-
-void check_inuse_factory_reset( int *time_start )
+static void exit_handler(int sig)
 {
-    struct stat sts;
-    if (stat(FACTORY_RESET_FILE, &sts) == -1 && errno == ENOENT)
-    {
-//      printf ("%s not present...\n", FACTORY_RESET_FILE);
-       	/* Set LED */
-       	system(str_sys_call_led[LED_RED]);
-       	/* Allow unit to run for 10 seconds where a button press causes factory reset */
-       	*time_start = TIMER1_EXPIRE;
-    }
-    else
-    {
-    	/* File Present */
-//      printf ("%s present, call factory reset...\n", FACTORY_RESET_FILE);
-       	remove(FACTORY_RESET_FILE);
-       	strcat (str_sys_call_check_factory_reset, "1");
-       	/* Call check-factory-reset.sh to perform a factory reset */
-        system(str_sys_call_check_factory_reset);
-        /* set mode straight into IN-USE */
-       	*time_start = TIMER1_INTERVAL;
-       	state = PB_STATE_INUSE;
-       	system(str_sys_call_led[LED_FLASH_GREEN]);
-    }
+	exit_request = 1;
 }
 
-
 /*
  ************** main Function  ****************
  *
  * @brief  Initialise
  *         Main Loop for both STARTUP mode (10 second period when a push button press causes
  *         a factory reset, and INUSE mode to process push button events based on length
- *         of push. Uses select (blocks) and read of input/event. The select time-out
- *         doesn't seem to work so a signal timer is used to set the initial START-UP time
- *         and then expire at intervals for time of press to be determined, so that
- *         the LED can change based on function. Push-button Release period is evaluated to
- *         determine operation.
+ *         of push. Blocks in select on the libpbmon fd, which becomes readable on input
+ *         events and on the timer that sets the initial START-UP time and then expires at
+ *         intervals for time of press to be determined, so that the LED can change based
+ *         on function. Push-button Release period is evaluated to determine operation.
  */
 int main (int argc, char **argv)
 {
+        const char *device;
+        const char *wdt_device = NULL;
+        const char *cmd_path = NULL;
+        const char *iso_spec = NULL;
+        gid_t cmd_gid = CMD_NO_GROUP;
+        int opt;
         int fd;
-        const char *device = argv[1];
-        struct input_event ev[64];
-        int i, rd;
         fd_set rdfs;
         int ret;
-        state = PB_STATE_START;
-        int time_start;
-        int count;
-
-        // push button timer press to release
-        struct timespec timer_start, timer_stop, time_duration;
-        double total_time;
         struct timeval timeout;
-
-        // Signal timer to change state from startup to inuse
-        timer_t timer1;
-        struct sigevent te;
-        struct itimerspec its;
         struct sigaction sa;
 
+        while ((opt = getopt(argc, argv, "w:t:s:W:P:UC:G:A:R:")) != -1)
+        {
+            switch (opt)
+            {
+            case 'w':
+                lat_wake.alert_us = strtoull(optarg, NULL, 0);
+                break;
+            case 't':
+                lat_timer.alert_us = strtoull(optarg, NULL, 0);
+                break;
+            case 's':
+                lat_loop.alert_us = strtoull(optarg, NULL, 0) * 1000;
+                break;
+            case 'W':
+                wdt_device = optarg;
+                break;
+            case 'P':
+                /* Failure leaves the external command in place */
+                pb_plugin_load(optarg);
+                break;
+            case 'U':
+                pbmon_use_uring(1);
+                break;
+            case 'C':
+                cmd_path = optarg;
+                break;
+            case 'G':
+                cmd_gid = (gid_t)strtoul(optarg, NULL, 0);
+                break;
+            case 'A':
+                iso_spec = (strcmp(optarg, "default") == 0) ? ISO_DEFAULT_SPEC : optarg;
+                break;
+            case 'R':
+                /* Failure leaves the factory reset script in place */
+                rst_open(optarg);
+                break;
+            default:
+                fprintf(stderr, "Usage: %s [-w wake_alert_us] [-t timer_alert_us] [-s stall_ms] "
+                        "[-W watchdog] [-P plugin.so[:arg]]... [-U] [-C socket [-G gid]] "
+                        "[-A isolation|default] [-R data_dir] device\n", argv[0]);
+                return 1;
+            }
+        }
+        device = argv[optind];
         if (!device) {
                 fprintf(stderr, "No device specified\n");
                 return 1;
         }
 
-        /* Wait for interface to become available */
-        count = 0;
-/*
-        while (count < 50)
+        /* SIGUSR1 prints the latency histograms */
+        sa.sa_flags = 0;
+        sa.sa_handler = report_handler;
+        sigemptyset(&sa.sa_mask);
+        sigaction(SIGUSR1, &sa, NULL);
+        /* SIGTERM/SIGINT exit the loop and disarm the watchdog */
+        sa.sa_handler = exit_handler;
+        sigaction(SIGTERM, &sa, NULL);
+        sigaction(SIGINT, &sa, NULL);
+
+        /* Before pbmon_init() - a factory reset may run there */
+        if (iso_spec && (iso_open(ISO_CGROUP_ROOT, iso_spec) < 0))
         {
-            if ((fd = open(device, O_RDONLY)) >= 0)
-            {
-            	printf("-------count=%d", count);
-                break;
-            }
-            else if (count == 49)
-            {
-                perror("evtest");
-                return EXIT_FAILURE;
-            }
-            count++
-			usleep(200000) // 200ns
+            /* As -P and -R - the actions still run, just not isolated */
+            printf("Isolation: %s not applied - actions run without isolation\n", iso_spec);
         }
-*/
-        // initialise
-        pb_initialise();
-        timer_start.tv_sec=0;
-        timer_start.tv_nsec=0;
-
-        printf("Start Push-Button Monitor\n");
-        printf("Start-Mode, press push-button for factory Reset\n");
+        if (cmd_path)
+            pbmon_use_command(cmd_path, cmd_gid);
 
-        /* Is there a file indicating factory-reset required on next boot */
-        check_inuse_factory_reset( &time_start );
-
-  		// set up signal timer
-        make_timer((char*)"Timer1", &timer1, time_start, TIMER1_INTERVAL);
+        /* Stall detection and hardware watchdog - armed before pbmon_init(), whose factory reset may hang */
+        live_open(wdt_device, LIVE_WDT_TIMEOUT, LOOP_TIMEOUT);
+        live_extend(LIVE_RESET_TIMEOUT);
+        if (pbmon_init(device, NULL) < 0)
+        {
+            live_suspend();
+            return EXIT_FAILURE;
+        }
+        live_restore();
+        fd = pbmon_fd();
 
         /* Main Loop */
-        while (1)
+        while (!exit_request)
         {
+            live_idle();
             FD_ZERO(&rdfs);
             FD_SET(fd, &rdfs);
             // select time-out
-            timeout.tv_sec  = 3;
+            timeout.tv_sec  = LOOP_TIMEOUT;
             timeout.tv_usec = 0;
-            /* Block on select until input or Signal ortmeout */
-            select(fd + 1, &rdfs, NULL, NULL, &timeout);
-            rd = read(fd, ev, sizeof(ev));
-            if (rd < (int) sizeof(struct input_event)) {
-                 if (errno != EINTR)
-                 {
-                	perror("read error");
-                   //return 1;
-                 }
-            }
-            else
+            /* Block on select until input, timer or Signal or timeout */
+            ret = select(fd + 1, &rdfs, NULL, NULL, &timeout);
+            live_wake();
+            if ((ret > 0) && (pbmon_dispatch() < 0))
             {
-                for (i = 0; i < rd / sizeof(struct input_event); i++)
-                {
-                    if (ev[i].type != EV_KEY)
-                        continue;
-//                  printf("i=%d code=%d value=%d\n", i, ev[i].code, ev[i].value);
-                    if (ev[i].code == 256)
-                    {
-                    	/* PUSH Button */
-                        if (ev[i].value == 1)
-                        {
-                        	/* start timer */
-                        	if((clock_gettime(CLOCK_REALTIME, &timer_start)) == -1) {
-                        	    perror("clock gettime");
-                        	    break;
-                        	 }
-//                        	 printf("Start time: %d.%09d\n", timer_start.tv_sec, timer_start.tv_nsec);
-                        }
-                        /* RELEASE Button */
-                        else if (ev[i].value == 0)
-                        {
-                        	total_time = test_time( &timer_start, &timer_stop, &time_duration);
-                        	if (total_time)
-                        	{
-//                   		printf("Stop time: %d.%09d\n", timer_stop.tv_sec, timer_stop.tv_nsec);
-//                   	        printf("Duration %d.%09d\n", time_duration.tv_sec, time_duration.tv_nsec);
-//                   	        printf("Total_time=%f\n",total_time);
-                    	            /* Call Function to perform actions */
-                      	            process_end_time((unsigned long)total_time);
-                    	            /* Reset */
-                    	            timer_start.tv_sec=0;
-                    	            timer_start.tv_nsec=0;
-                    	            system(str_sys_call_led[LED_FLASH_GREEN]);
-                        	}
-                        	else
-                        	{
-                        	    printf("Invalid Time\n");
-                        	}
-                        }
-                    }  // if ev[i].code
-                }  // for
-            } // else
-            /* Process the time so far to determine LED changes */
-            total_time = test_time( &timer_start, &timer_stop, &time_duration);
-            if (total_time)
+                /* Leave the watchdog armed - a dead button becomes a reset */
+                pbmon_close();
+                return EXIT_FAILURE;
+            }
+            if (report_request)
             {
-                process_time((unsigned long)total_time);
+                report_request = 0;
+                lat_report(&lat_wake);
+                lat_report(&lat_timer);
+                lat_report(&lat_loop);
+                gsc_report();
             }
         } // while
-        ioctl(fd, EVIOCGRAB, (void*)0);
-        close(fd);
+        live_suspend();
+        pbmon_close();
+        iso_close();
         return EXIT_SUCCESS;
-
-
-
-
-
 }
@@ -0,0 +1,223 @@
+/**********************************************************************************************************************
+*
+*   File:           pb_plugin.c
+*
+*   Summary:        In-process action and LED driver plugins
+*
+*   Element:        IESv06
+*
+*   Platform:       Linux
+*
+*   Description:  Loads plugins (see pb_plugin.h) and dispatches actions and LED changes to
+*                 them. Each action and the LED has one owner: the last loaded plugin that
+*                 claims it, otherwise the built-in "exec" plugin, which runs the external
+*                 command string with system() - in its own cgroup and at low I/O priority
+*                 when action isolation is on (pb_isolate.h). LED commands are not isolated.
+*
+*******************************************************************************************************************/
+
+#include <dlfcn.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "pb_isolate.h"
+#include "pb_plugin.h"
+
+/*
+ * Defines
+ */
+#define PB_PLUGIN_ACTIONS   (FR_DEC_FACTORY_RESET + 1)
+
+/*
+ * Static - built-in fallback plugin
+ */
+static int exec_execute( unsigned int action, const char *cmd )
+{
+	return(iso_system(action, cmd));
+}
+
+static const struct pb_plugin pb_plugin_exec = {
+	.abi_version = PB_PLUGIN_ABI_VERSION,
+	.name        = "exec",
+	.execute     = exec_execute,
+};
+
+/*
+ * Static - loaded plugins and owner of each action / the LED
+ */
+static const struct pb_plugin *pb_plugins[PB_PLUGIN_MAX];
+static void *pb_plugin_handles[PB_PLUGIN_MAX];
+static unsigned int pb_plugin_count;
+static const struct pb_plugin *pb_plugin_action_owner[PB_PLUGIN_ACTIONS];
+static const struct pb_plugin *pb_plugin_led_owner;
+static pb_plugin_queue_fn pb_plugin_write_queue;
+
+/*
+ **************  Functions  ****************
+ */
+
+/*
+ * pb_plugin_load
+ *
+ * @brief Loads a plugin and makes it the owner of the actions / LED it claims.
+ * @param spec - shared object path, optionally followed by ':' and an init argument
+ * @return 0 on success, -1 on failure.
+ */
+int pb_plugin_load( const char *spec )
+{
+	char path[256];
+	const char *arg = NULL;
+	const struct pb_plugin *plugin;
+	pb_plugin_entry_fn entry;
+	void *handle;
+	char *colon;
+	unsigned int action;
+
+	if (pb_plugin_count == PB_PLUGIN_MAX)
+	{
+		printf("Plugin %s: too many plugins\n", spec);
+		return(-1);
+	}
+	snprintf(path, sizeof(path), "%s", spec);
+	if ((colon = strchr(path, ':')) != NULL)
+	{
+		*colon = '\0';
+		arg = colon + 1;
+	}
+
+	handle = dlopen(path, RTLD_NOW | RTLD_LOCAL);
+	if (handle == NULL)
+	{
+		printf("Plugin %s: %s\n", path, dlerror());
+		return(-1);
+	}
+	entry = (pb_plugin_entry_fn)dlsym(handle, PB_PLUGIN_ENTRY);
+	plugin = entry ? entry() : NULL;
+	if ((plugin == NULL) || (plugin->abi_version < PB_PLUGIN_ABI_MIN) ||
+	    (plugin->abi_version > PB_PLUGIN_ABI_VERSION))
+	{
+		printf("Plugin %s: no %s or ABI version %u (expected %u..%u)\n", path, PB_PLUGIN_ENTRY,
+		       plugin ? plugin->abi_version : 0, PB_PLUGIN_ABI_MIN, PB_PLUGIN_ABI_VERSION);
+		dlclose(handle);
+		return(-1);
+	}
+	if ((plugin->init != NULL) && (plugin->init(arg) != 0))
+	{
+		printf("Plugin %s: init failed\n", plugin->name);
+		dlclose(handle);
+		return(-1);
+	}
+
+	for (action = 0; action < PB_PLUGIN_ACTIONS; action++)
+	{
+		if ((plugin->actions & PB_PLUGIN_ACTION(action)) && (plugin->execute != NULL))
+			pb_plugin_action_owner[action] = plugin;
+	}
+	if (plugin->leds && (plugin->set_led != NULL))
+		pb_plugin_led_owner = plugin;
+
+	pb_plugins[pb_plugin_count] = plugin;
+	pb_plugin_handles[pb_plugin_count] = handle;
+	pb_plugin_count++;
+	printf("Plugin %s loaded (actions 0x%x%s)\n", plugin->name, plugin->actions,
+	       plugin->leds ? ", LED" : "");
+	return(0);
+}
+
+/*
+ * pb_plugin_execute
+ *
+ * @brief Performs action with its owning plugin, or runs cmd.
+ * @return status as system().
+ */
+int pb_plugin_execute( unsigned int action, const char *cmd )
+{
+	const struct pb_plugin *plugin = NULL;
+
+	if (action < PB_PLUGIN_ACTIONS)
+		plugin = pb_plugin_action_owner[action];
+	if (plugin == NULL)
+		plugin = &pb_plugin_exec;
+	return(plugin->execute(action, cmd));
+}
+
+/*
+ * pb_plugin_set_write_queue
+ *
+ * @brief Sets (or clears, with NULL) where described LED writes are queued.
+ */
+void pb_plugin_set_write_queue( pb_plugin_queue_fn queue )
+{
+	pb_plugin_write_queue = queue;
+}
+
+/*
+ * pb_plugin_set_led
+ *
+ * @brief Drives the LED with the LED driver plugin - queueing its writes when a
+ *        write queue is set and the plugin can describe them - or runs cmd.
+ * @return 0 on success.
+ */
+int pb_plugin_set_led( enum led_state led, const char *cmd )
+{
+	const struct pb_plugin *plugin = pb_plugin_led_owner;
+	struct pb_plugin_write writes[PB_PLUGIN_WRITES_MAX];
+	int i, n;
+
+	/* set_led.sh is quick - keep it out of the low-weight action cgroup */
+	if (plugin == NULL)
+		return(system(cmd));
+
+	if ((pb_plugin_write_queue != NULL) && (plugin->abi_version >= 2) && (plugin->led_writes != NULL))
+	{
+		n = plugin->led_writes(led, writes, PB_PLUGIN_WRITES_MAX);
+		if (n >= 0)
+		{
+			for (i = 0; i < n; i++)
+			{
+				if (pb_plugin_write_queue(&writes[i]) < 0)
+					return(-1);
+			}
+			return(0);
+		}
+	}
+	return(plugin->set_led(led));
+}
+
+/*
+ * pb_plugin_cancel
+ *
+ * @brief Tells every plugin that action was abandoned (FR_DEC_NONE on exit).
+ */
+void pb_plugin_cancel( unsigned int action )
+{
+	unsigned int i;
+
+	for (i = 0; i < pb_plugin_count; i++)
+	{
+		if (pb_plugins[i]->cancel != NULL)
+			pb_plugins[i]->cancel(action);
+	}
+}
+
+/*
+ * pb_plugin_unload
+ *
+ * @brief Cancels outstanding work and unloads all plugins.
+ */
+void pb_plugin_unload( void )
+{
+	unsigned int i;
+
+	pb_plugin_cancel(FR_DEC_NONE);
+	memset(pb_plugin_action_owner, 0, sizeof(pb_plugin_action_owner));
+	pb_plugin_led_owner = NULL;
+	for (i = 0; i < pb_plugin_count; i++)
+	{
+		dlclose(pb_plugin_handles[i]);
+		pb_plugins[i] = NULL;
+		pb_plugin_handles[i] = NULL;
+	}
+	pb_plugin_count = 0;
+}
@@ -0,0 +1,90 @@
+/**********************************************************************************************************************
+*
+*   File:           pb_plugin.h
+*
+*   Summary:        In-process action and LED driver plugin ABI
+*
+*   Element:        IESv06
+*
+*   Platform:       Linux
+*
+*   Description:  A plugin is a shared object exporting
+*
+*                   const struct pb_plugin *pb_plugin_entry( void );
+*
+*                 loaded at start-up with dlopen (pb_monitor -P path[:arg]). It may handle
+*                 any set of actions (enum fr_decision) and/or drive the LED (enum led_state).
+*                 Entry points are called directly from the event loop, so they must not
+*                 block for long. Anything a plugin does not handle falls back to the
+*                 built-in "exec" plugin, which runs the external command as before.
+*
+*                 The ABI version is bumped whenever struct pb_plugin or the meaning of
+*                 the enums changes. Fields are only ever appended, so older plugins down
+*                 to PB_PLUGIN_ABI_MIN are still accepted; anything else is refused.
+*
+*                 ABI 2 - led_writes, so the io_uring reactor can batch LED writes.
+*
+*******************************************************************************************************************/
+#ifndef PB_PLUGIN_H
+#define PB_PLUGIN_H
+
+#include <stdint.h>
+
+#include "pb_flightrec.h"      /* enum fr_decision */
+#include "pb_press.h"          /* enum led_state */
+
+/*
+ * Defines
+ */
+#define PB_PLUGIN_ABI_VERSION   2
+#define PB_PLUGIN_ABI_MIN       1
+#define PB_PLUGIN_WRITES_MAX    4
+#define PB_PLUGIN_ENTRY         "pb_plugin_entry"
+#define PB_PLUGIN_MAX           8
+#define PB_PLUGIN_ACTION(dec)   (1u << (dec))       /* bit in pb_plugin.actions */
+
+/*
+ * One file write, described rather than performed
+ */
+struct pb_plugin_write {
+	int          fd;
+	const char   *data;             /* must stay valid - static data only */
+	unsigned int len;
+};
+
+/*
+ * Plugin descriptor - returned by pb_plugin_entry()
+ */
+struct pb_plugin {
+	uint32_t    abi_version;        /* PB_PLUGIN_ABI_VERSION */
+	const char  *name;
+	uint32_t    actions;            /* PB_PLUGIN_ACTION() bits handled by execute */
+	uint32_t    leds;               /* non-zero if set_led drives the LED */
+
+	/* Called once after loading; arg is the text after ':' in -P, or NULL.
+	 * Return 0 on success - a plugin that fails is unloaded. */
+	int  (*init)( const char *arg );
+	/* Perform action; cmd is the external command it replaces. Return as system(). */
+	int  (*execute)( unsigned int action, const char *cmd );
+	/* Drive the LED. Return 0 on success. */
+	int  (*set_led)( enum led_state led );
+	/* Abandon work in progress: action is FR_DEC_CANCEL for a cancelled press,
+	 * FR_DEC_NONE when the monitor exits. May be NULL. */
+	void (*cancel)( unsigned int action );
+
+	/* ABI 2 - may be NULL. Describe the LED change as up to max writes, applied in order,
+	 * instead of doing them. Return the number of writes, or -1 to use set_led. */
+	int  (*led_writes)( enum led_state led, struct pb_plugin_write *writes, int max );
+};
+
+typedef const struct pb_plugin *(*pb_plugin_entry_fn)( void );
+typedef int (*pb_plugin_queue_fn)( const struct pb_plugin_write *write );
+
+int  pb_plugin_load( const char *spec );
+int  pb_plugin_execute( unsigned int action, const char *cmd );
+int  pb_plugin_set_led( enum led_state led, const char *cmd );
+void pb_plugin_cancel( unsigned int action );
+void pb_plugin_set_write_queue( pb_plugin_queue_fn queue );
+void pb_plugin_unload( void );
+
+#endif /* PB_PLUGIN_H */
@@ -0,0 +1,380 @@
+/**********************************************************************************************************************
+*
+*   File:           pb_press.c
+*
+*   Summary:        Push-button press timing, classification, LED and action dispatch
+*
+*   Element:        IESv06
+*
+*   Platform:       Linux
+*
+*   Description:  Measures the press time and classifies it (see pb_monitor.c for the
+*                 periods), drives the LED while the button is held and runs the action
+*                 on release. The device and the timerfd are handled by libpbmon (pbmon.c),
+*                 the main loop by its host (pb_monitor.c).
+*
+*******************************************************************************************************************/
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <sys/stat.h>
+
+#include "pb_flightrec.h"
+#include "pb_gsc.h"
+#include "pb_liveness.h"
+#include "pb_plugin.h"
+#include "pb_press.h"
+#include "pb_probes.h"
+#include "pb_reset.h"
+
+/*
+ * Global - mode of operation
+ */
+enum pb_state pb_press_state;
+
+/*
+ * Global Strings - Bash script system calls
+ */
+static char str_sys_call_opt_dir[]  = "mkdir -p /opt/monitors/";
+const char pb_sys_call_check_factory_reset[] = "/usr/local/bin/check-factory-reset.sh";   /* + " 0|1" */
+static char str_sys_call_reboot[] = "reboot";
+static char str_sys_call_shutdown[] = "shutdown -h now";
+static char str_sys_call_led[][16] = {
+        {"./set_led.sh 0"},
+        {"./set_led.sh 1"},
+        {"./set_led.sh 2"},
+        {"./set_led.sh 3"},
+        {"./set_led.sh 4"}
+};
+
+/*
+ * Global - flag file for a factory reset at the next start-up (tests move it)
+ */
+const char *pb_factory_reset_file = FACTORY_RESET_FILE;
+
+/*
+ * Global - last press threshold (seconds) for which the LED was set
+ */
+unsigned long pb_threshold_level;
+
+/*
+ * Global - LED between presses: heartbeat, solid green while a factory reset's old
+ * data is erased, flashing red once a factory reset reboot is under way
+ */
+enum led_state pb_led_idle = LED_FLASH_GREEN;
+
+/*
+ **************  Functions  ****************
+ */
+
+/*
+ * pb_initialise
+ *
+ * @brief Disables the GSC push-button hard reset and creates monitor directory.
+ * @return void.
+ */
+void pb_initialise( void )
+{
+	/* Disable the GSC push-button hard reset - R10 is left to the kernel gsc driver */
+	if (gsc_open(GSC_BUS, GSC_ADDR) == 0)
+	{
+		gsc_disable_pb_reset();
+		gsc_close();
+	}
+	/* Make Directory if not present */
+	system(str_sys_call_opt_dir);
+}
+
+/*
+ * set_led
+ *
+ * @brief Drives the bi-colour LED to led, with the LED driver plugin if loaded.
+ */
+void pb_set_led( enum led_state led )
+{
+	uint64_t start_ns = pb_time_ns(CLOCK_MONOTONIC);
+
+	pb_plugin_set_led(led, str_sys_call_led[led]);
+	PB_PROBE2(led_write, led, start_ns);
+}
+
+/*
+ * pb_run_action
+ *
+ * @brief Runs an action (plugin, or the command) and waits for it to complete.
+ * @param cmd    - command string
+ * @param action - enum fr_decision, for tracing
+ * @return system() status.
+ */
+int pb_run_action( const char *cmd, unsigned int action )
+{
+	uint64_t start_ns = pb_time_ns(CLOCK_MONOTONIC);
+	int status;
+
+	/* Disarm the watchdog only to let the system go down. The loop is blocked while
+	   any other action runs - the watchdog stays armed, with time for the action */
+	if ((action == FR_DEC_REBOOT) || (action == FR_DEC_SHUTDOWN))
+		live_suspend();
+	else
+		live_extend((action == FR_DEC_FACTORY_RESET) ? LIVE_RESET_TIMEOUT : LIVE_ACTION_TIMEOUT);
+	PB_PROBE2(action_spawn, action, pb_press_state);
+	status = pb_plugin_execute(action, cmd);
+	PB_PROBE3(action_exit, action, status, start_ns);
+	if ((action != FR_DEC_REBOOT) && (action != FR_DEC_SHUTDOWN))
+		live_restore();
+	return(status);
+}
+
+/*
+ * pb_timespec_diff
+ *
+ * @brief Called from pb_test_time to calculates pb press time and returns in result.
+ */
+void pb_timespec_diff(const struct timespec *start, const struct timespec *stop,
+                      struct timespec *result)
+{
+    if ((stop->tv_nsec - start->tv_nsec) < 0)
+    {
+        result->tv_sec = stop->tv_sec - start->tv_sec - 1;
+        result->tv_nsec = stop->tv_nsec - start->tv_nsec + 1000000000UL;
+    }
+    else
+    {
+        result->tv_sec = stop->tv_sec - start->tv_sec;
+        result->tv_nsec = stop->tv_nsec - start->tv_nsec;
+    }
+}
+
+/*
+ * pb_test_time
+ *
+ * @brief If start time is set, raed curent time and call function to calculate time.
+ */
+double pb_test_time (const struct timespec *start, struct timespec *stop, struct timespec *duration)
+{
+	/* invalid if no start time set */
+	if (( start->tv_sec > 0 ) || (start->tv_nsec > 0 ))
+	{
+		/* current time */
+        if((clock_gettime( CLOCK_REALTIME, stop)) == -1)
+        {
+            perror("clock gettime");
+            return (0);
+	    }
+	    pb_timespec_diff ( start, stop, duration);
+        return ((double)duration->tv_sec + ((double)duration->tv_nsec /1000000000));
+	}
+	return (0);
+}
+
+/*
+ * pb_process_time
+ *
+ * @brief Process the time so far to determine LED changes.
+ *        The LED is only written when a threshold is crossed.
+ *        Note accurate to time + timer interval period
+ */
+void pb_process_time( unsigned long seconds)
+{
+    unsigned long level;
+
+    if (pb_press_state == PB_STATE_INUSE)
+    {
+    	level = (seconds >= 15) ? 15 : (seconds >= 10) ? 10 : (seconds >= 5) ? 5 : 0;
+    	if (level == pb_threshold_level)
+    	    return;
+    	pb_threshold_level = level;
+    	PB_PROBE3(threshold, pb_press_state, level, seconds * 1000);
+
+    	if (level == 15)
+    	{
+    	    // return to heartbeat
+    	    pb_set_led(pb_led_idle);
+    	}
+        else if (level == 10)
+        {
+    	    // Flash red - release for shutdown
+    	    pb_set_led(LED_FLASH_RED);
+        }
+    	else if (level == 5)
+    	{
+			// Solid red - release for factory reset
+    	    pb_set_led(LED_RED);
+        }
+    }
+}
+
+/*
+ * reset_by_swap
+ *
+ * @brief Factory reset by snapshot swap (pb_reset.h), if in use: swaps in empty data
+ *        and reboots, the LED flashing red until the system goes down.
+ * @return 0 if done, -1 to run the factory reset action instead.
+ */
+static int reset_by_swap( void )
+{
+	if (rst_swap() < 0)
+		return(-1);
+	pb_led_idle = LED_FLASH_RED;
+	pb_set_led(pb_led_idle);
+	fr_record(FR_ACTION, pb_press_state, FR_DEC_REBOOT);
+	fr_flush();
+	pb_run_action(str_sys_call_reboot, FR_DEC_REBOOT);
+	return(0);
+}
+
+/*
+ * pb_next_threshold
+ *
+ * @brief Next LED threshold of pb_process_time() after a press of seconds.
+ * @return seconds, or 0 if none is left.
+ */
+unsigned long pb_next_threshold( unsigned long seconds )
+{
+	return((seconds < 5) ? 5 : (seconds < 10) ? 10 : (seconds < 15) ? 15 : 0);
+}
+
+/*
+ * pb_classify_press
+ *
+ * @brief Classifies a press of the given length in the current mode.
+ * @return enum fr_decision.
+ */
+unsigned int pb_classify_press( unsigned long seconds)
+{
+	if (seconds >= 15)
+		return(FR_DEC_CANCEL);
+	if (seconds >= 10)
+		return(FR_DEC_SHUTDOWN);
+	if (seconds >= 5)
+		return(FR_DEC_FACTORY_RESET_NEXT);
+	/* less than 5 seconds */
+	return((pb_press_state == PB_STATE_INUSE) ? FR_DEC_REBOOT : FR_DEC_FACTORY_RESET);
+}
+
+/*
+ * pb_process_end_time
+ *
+ * @brief Process the final time (accurate) to determine which button functionality to implement
+ *        reboot; factory reset (on next power-up); shutdown; cancel
+ */
+void pb_process_end_time( unsigned long seconds)
+{
+	pb_process_decision(pb_classify_press(seconds));
+}
+
+/*
+ * pb_process_decision
+ *
+ * @brief Carries out a classified press (enum fr_decision) - from a release, or
+ *        requested directly over the command socket.
+ */
+void pb_process_decision( unsigned int decision )
+{
+	char cmd[PB_SYS_CALL_LEN];
+	FILE *file_ptr;
+
+	fr_record(FR_DECISION, pb_press_state, decision);
+	switch (decision)
+	{
+	case FR_DEC_CANCEL:
+	   	printf("Long Push-Button Press (15+sec) - cancelled\n");
+	   	pb_plugin_cancel(FR_DEC_CANCEL);
+	   	break;
+
+	case FR_DEC_SHUTDOWN:
+    	printf("Long Push-Button Press (10+sec) - shutdown\n");
+    	fr_record(FR_ACTION, pb_press_state, FR_DEC_SHUTDOWN);
+    	fr_flush();
+    	pb_run_action(str_sys_call_shutdown, FR_DEC_SHUTDOWN);
+    	break;
+
+	case FR_DEC_FACTORY_RESET_NEXT:
+    	printf("Long Push-Button Press (5+sec) - Enter factory reset on next reboot\n");
+    	/* With snapshot swap, swap now - the next boot is the reset */
+    	if (rst_swap() == 0)
+    	    break;
+        /* Create File to be checked on start-up */
+    	file_ptr = fopen(pb_factory_reset_file, "w");
+    	if (file_ptr == NULL)
+    	{
+    	    perror(pb_factory_reset_file);
+    	}
+    	else
+    	{
+    	    fclose(file_ptr);
+    	}
+    	break;
+
+	case FR_DEC_REBOOT:
+		printf("Short Push-ButtonPress (less 5sec ) - reboot\n");
+		fr_record(FR_ACTION, pb_press_state, FR_DEC_REBOOT);
+		fr_flush();
+		pb_run_action(str_sys_call_reboot, FR_DEC_REBOOT);
+		break;
+
+	case FR_DEC_FACTORY_RESET:
+		/* STARTUP - Factory reset */
+		printf("Factory Reset\n");
+		fr_record(FR_ACTION, pb_press_state, FR_DEC_FACTORY_RESET);
+		fr_flush();
+		if (reset_by_swap() < 0)
+		{
+			snprintf(cmd, sizeof(cmd), "%s 1", pb_sys_call_check_factory_reset);
+			/* Call check-factory-reset.sh to perform a factory reset */
+			pb_run_action(cmd, FR_DEC_FACTORY_RESET);
+		}
+	    /* set mode to IN-USE */
+   		pb_press_state = PB_STATE_INUSE;
+   		// return to heartbeat
+	    pb_set_led(pb_led_idle);
+	    break;
+	}
+}
+
+/*
+ * pb_check_inuse_factory_reset
+ *
+ * @brief  Is there a file indicating factory-reset was requested IN-USE
+ *         in which case perform factory-reset, otherwise STARTUP by setting
+ *         LED to solid red, and wait time to 10 seconds (allow pb press to
+ *         immediate factory reset). Starts erasing the data a previous factory reset
+ *         (snapshot swap) left, solid green once in use until done.
+ */
+
+void pb_check_inuse_factory_reset( int *time_start )
+{
+    char cmd[PB_SYS_CALL_LEN];
+    struct stat sts;
+    if (stat(pb_factory_reset_file, &sts) == -1 && errno == ENOENT)
+    {
+//      printf ("%s not present...\n", FACTORY_RESET_FILE);
+       	/* Set LED */
+       	pb_set_led(LED_RED);
+       	/* Allow unit to run for 10 seconds where a button press causes factory reset */
+       	*time_start = TIMER1_EXPIRE;
+       	if (rst_cleanup() > 0)
+       	    pb_led_idle = LED_GREEN;
+    }
+    else
+    {
+    	/* File Present */
+//      printf ("%s present, call factory reset...\n", FACTORY_RESET_FILE);
+       	remove(pb_factory_reset_file);
+       	fr_record(FR_ACTION, pb_press_state, FR_DEC_FACTORY_RESET);
+       	fr_flush();
+       	if (reset_by_swap() < 0)
+       	{
+       	    snprintf(cmd, sizeof(cmd), "%s 1", pb_sys_call_check_factory_reset);
+       	    /* Call check-factory-reset.sh to perform a factory reset */
+       	    pb_run_action(cmd, FR_DEC_FACTORY_RESET);
+       	}
+        /* set mode straight into IN-USE */
+       	*time_start = TIMER1_INTERVAL;
+       	pb_press_state = PB_STATE_INUSE;
+       	pb_set_led(pb_led_idle);
+    }
+}
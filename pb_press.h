@@ -0,0 +1,63 @@
+/**********************************************************************************************************************
+*
+*   File:           pb_press.h
+*
+*   Summary:        Push-button press timing, classification, LED and action dispatch
+*
+*   Element:        IESv06
+*
+*   Platform:       Linux
+*
+*   Description:  Core of pb_monitor, kept free of device and timer handling so that it
+*                 can be built on the host for tests/ and benchmarks.
+*
+*******************************************************************************************************************/
+#ifndef PB_PRESS_H
+#define PB_PRESS_H
+
+#include <time.h>
+
+#include "pbmon.h"            /* enum pb_state */
+
+/*
+ * Defines
+ */
+#define TIMER1_EXPIRE   10     /* seconds */
+#define TIMER1_INTERVAL 2
+#define FACTORY_RESET_FILE  "/opt/monitors/fc-set"
+#define PB_SYS_CALL_LEN     64     /* command with its argument */
+
+/*
+ * Enumuration
+ */
+enum led_state {
+	LED_OFF,
+	LED_GREEN,
+	LED_RED,
+	LED_FLASH_GREEN,
+	LED_FLASH_RED
+};
+
+/*
+ * Globals
+ */
+extern enum pb_state pb_press_state;
+extern const char pb_sys_call_check_factory_reset[];
+extern unsigned long pb_threshold_level;
+extern enum led_state pb_led_idle;
+extern const char *pb_factory_reset_file;
+
+void pb_initialise( void );
+void pb_set_led( enum led_state led );
+int pb_run_action( const char *cmd, unsigned int action );
+void pb_timespec_diff(const struct timespec *start, const struct timespec *stop,
+                      struct timespec *result);
+double pb_test_time (const struct timespec *start, struct timespec *stop, struct timespec *duration);
+void pb_process_time( unsigned long seconds);
+unsigned long pb_next_threshold( unsigned long seconds );
+unsigned int pb_classify_press( unsigned long seconds);
+void pb_process_end_time( unsigned long seconds);
+void pb_process_decision( unsigned int decision );
+void pb_check_inuse_factory_reset( int *time_start );
+
+#endif /* PB_PRESS_H */
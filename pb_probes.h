@@ -0,0 +1,79 @@
+/**********************************************************************************************************************
+*
+*   File:           pb_probes.h
+*
+*   Summary:        Static (USDT) tracepoints on the push-button hot path
+*
+*   Element:        IESv06
+*
+*   Platform:       Linux
+*
+*   Description:  Probes use the systemtap <sys/sdt.h> header when the toolchain has it, so a
+*                 normal build can be traced in production with perf or bpftrace. A probe
+*                 that is not attached is a single NOP. Without the header, pb_sdt.h emits the
+*                 same notes on the targets it knows; elsewhere they compile away, with a
+*                 warning.
+*
+*                 Provider "pb_monitor", probes and arguments:
+*                   event_read   (nevents, kernel_ns, read_ns)       input event clock ns
+*                   press_start  (state, kernel_ns)                  input event clock ns
+*                   threshold    (state, level_s, press_ms)
+*                   release      (state, press_ms)
+*                   led_write    (led_state, start_ns)               CLOCK_MONOTONIC ns
+*                   action_spawn (action, state)
+*                   action_exit  (action, status, start_ns)          CLOCK_MONOTONIC ns
+*                   deadline     (late_ns, pending)                  scheduler deadline fired
+*                   i2c_xfer     (reg, retries, start_ns)            CLOCK_MONOTONIC ns
+*
+*                 CLOCK_MONOTONIC arguments are comparable with bpftrace 'nsecs'. The input
+*                 event clock is CLOCK_MONOTONIC (EVIOCSCLOCKID), or CLOCK_REALTIME if the
+*                 device is not an evdev.
+*                 See bpftrace/ for latency histogram scripts.
+*
+*******************************************************************************************************************/
+#ifndef PB_PROBES_H
+#define PB_PROBES_H
+
+#include <stdint.h>
+#include <time.h>
+
+#if defined(__has_include)
+#if __has_include(<sys/sdt.h>)
+#include <sys/sdt.h>
+#define PB_HAVE_SDT
+#endif
+#endif
+
+/* No systemtap headers in the sysroot - the minimal notes in pb_sdt.h */
+#if !defined(PB_HAVE_SDT) && defined(__GNUC__) && \
+    (defined(__x86_64__) || defined(__i386__) || defined(__arm__) || defined(__aarch64__))
+#include "pb_sdt.h"
+#define PB_HAVE_SDT
+#endif
+
+#ifdef PB_HAVE_SDT
+#define PB_PROBE1(name, a1)             DTRACE_PROBE1(pb_monitor, name, a1)
+#define PB_PROBE2(name, a1, a2)         DTRACE_PROBE2(pb_monitor, name, a1, a2)
+#define PB_PROBE3(name, a1, a2, a3)     DTRACE_PROBE3(pb_monitor, name, a1, a2, a3)
+#else
+#warning "no <sys/sdt.h> for this target - static tracepoints compiled out"
+/* arguments are not evaluated */
+#define PB_PROBE1(name, a1)             do { (void)sizeof(a1); } while (0)
+#define PB_PROBE2(name, a1, a2)         do { (void)sizeof(a1); (void)sizeof(a2); } while (0)
+#define PB_PROBE3(name, a1, a2, a3)     do { (void)sizeof(a1); (void)sizeof(a2); (void)sizeof(a3); } while (0)
+#endif
+
+/*
+ * pb_time_ns
+ *
+ * @brief Reads clock clk in nanoseconds (vDSO, no system call).
+ */
+static inline uint64_t pb_time_ns( clockid_t clk )
+{
+	struct timespec ts;
+
+	clock_gettime(clk, &ts);
+	return ((uint64_t)ts.tv_sec * 1000000000ULL) + ts.tv_nsec;
+}
+
+#endif /* PB_PROBES_H */
@@ -0,0 +1,388 @@
+/**********************************************************************************************************************
+*
+*   File:           pb_reset.c
+*
+*   Summary:        Factory reset by snapshot swap, old data erased in the background
+*
+*   Element:        IESv06
+*
+*   Platform:       Linux (overlayfs)
+*
+*   Description:  See pb_reset.h. The swap is ordered so that a power cut at any point leaves
+*                 either the old or the new generation current: the new directories and the
+*                 pending file are made durable before the rename that switches the pointer.
+*
+*******************************************************************************************************************/
+
+#define _XOPEN_SOURCE 700       /* nftw() */
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <ftw.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+
+#include "pb_flightrec.h"
+#include "pb_isolate.h"
+#include "pb_reset.h"
+
+/*
+ * Defines
+ */
+#define RST_NAME_LEN        32
+#define RST_ID_LEN          40      /* boot id, 36 characters */
+#define RST_FDS             16      /* nftw() descriptors */
+#define RST_PATH_LEN        (128 + 1 + 256)     /* rst_dir / directory entry */
+#define RST_OLD_MAX         16      /* generations erased by one cleanup */
+
+/*
+ * Static
+ */
+static char rst_dir[128];
+static char rst_current[RST_NAME_LEN];
+static int rst_on;
+static pid_t rst_pid;
+static unsigned long rst_erased;
+static char rst_old[RST_OLD_MAX][RST_NAME_LEN];     /* listed for the erase */
+static unsigned int rst_old_count;
+static long rst_old_last = -1;                      /* highest generation listed */
+
+/*
+ **************  Functions  ****************
+ */
+
+/*
+ * rst_path
+ *
+ * @brief Builds rst_dir/name in path (RST_PATH_LEN).
+ */
+static char *rst_path( char *path, const char *name )
+{
+	snprintf(path, RST_PATH_LEN, "%s/%s", rst_dir, name);
+	return(path);
+}
+
+/*
+ * rst_read
+ *
+ * @brief Reads the first line of the file path into buf.
+ * @return 0, or -1 if it cannot be read.
+ */
+static int rst_read( const char *path, char *buf, size_t len )
+{
+	ssize_t n;
+	int fd;
+
+	if ((fd = open(path, O_RDONLY | O_CLOEXEC)) == -1)
+		return(-1);
+	n = read(fd, buf, len - 1);
+	close(fd);
+	if (n < 0)
+		return(-1);
+	buf[n] = '\0';
+	buf[strcspn(buf, "\n")] = '\0';
+	return(0);
+}
+
+/*
+ * rst_sync
+ *
+ * @brief fsync()s the directory path, so entries made in it survive a power cut.
+ */
+static int rst_sync( const char *path )
+{
+	int fd, ret;
+
+	if ((fd = open(path, O_RDONLY | O_DIRECTORY | O_CLOEXEC)) == -1)
+		return(-1);
+	ret = fsync(fd);
+	close(fd);
+	return(ret);
+}
+
+/*
+ * rst_generation
+ *
+ * @brief Parses a generation name, gen.<n>.
+ * @return n, or -1 if name is not one.
+ */
+static long rst_generation( const char *name )
+{
+	char *end;
+	long n;
+
+	if (strncmp(name, RST_GEN, strlen(RST_GEN)) != 0)
+		return(-1);
+	n = strtol(name + strlen(RST_GEN), &end, 10);
+	if ((end == name + strlen(RST_GEN)) || (*end != '\0') || (n < 0))
+		return(-1);
+	return(n);
+}
+
+/*
+ * rst_pending
+ *
+ * @brief Has a swap been made since this boot? The mounted generation is then
+ *        not current, and must not be erased.
+ */
+static int rst_pending( void )
+{
+	char path[RST_PATH_LEN];
+	char pending[RST_ID_LEN], boot_id[RST_ID_LEN];
+
+	if (rst_read(rst_path(path, RST_PENDING), pending, sizeof(pending)) < 0)
+		return(0);
+	/* Unknown boot - assume not rebooted, erasing would be worse than waiting */
+	if (rst_read(RST_BOOT_ID, boot_id, sizeof(boot_id)) < 0)
+		return(1);
+	return(strcmp(pending, boot_id) == 0);
+}
+
+/*
+ * rst_erase
+ *
+ * @brief nftw() callback - removes one entry, deepest first. Errors are skipped.
+ */
+static int rst_erase( const char *fpath, const struct stat *sb, int typeflag, struct FTW *ftwbuf )
+{
+	if (remove(fpath) == 0)
+		rst_erased++;
+	return(0);
+}
+
+/*
+ * rst_list
+ *
+ * @brief Lists the generations other than current in rst_old, and removes a link left
+ *        by an interrupted swap. Only the listed generations are erased, so a swap
+ *        made during the erase is safe.
+ * @return number listed, or -1 on failure.
+ */
+static int rst_list( void )
+{
+	char path[RST_PATH_LEN];
+	struct dirent *de;
+	DIR *dir;
+	long n;
+
+	if ((dir = opendir(rst_dir)) == NULL)
+	{
+		perror(rst_dir);
+		return(-1);
+	}
+	rst_old_count = 0;
+	while ((de = readdir(dir)) != NULL)
+	{
+		if (strcmp(de->d_name, RST_CURRENT ".tmp") == 0)
+		{
+			unlink(rst_path(path, de->d_name));
+			continue;
+		}
+		n = rst_generation(de->d_name);
+		if ((n < 0) || (strcmp(de->d_name, rst_current) == 0) || (rst_old_count == RST_OLD_MAX))
+			continue;
+		strcpy(rst_old[rst_old_count++], de->d_name);
+		if (n > rst_old_last)
+			rst_old_last = n;
+	}
+	closedir(dir);
+	return(rst_old_count);
+}
+
+/*
+ * rst_erase_old
+ *
+ * @brief Removes the generations listed by rst_list().
+ */
+static void rst_erase_old( void )
+{
+	char path[RST_PATH_LEN];
+	unsigned int i;
+
+	for (i = 0; i < rst_old_count; i++)
+	{
+		rst_erased = 0;
+		nftw(rst_path(path, rst_old[i]), rst_erase, RST_FDS, FTW_DEPTH | FTW_PHYS);
+		printf("Factory reset: erased %s (%lu entries)\n", path, rst_erased);
+	}
+}
+
+/*
+ * rst_open
+ *
+ * @brief Uses snapshot swap for factory resets, with the data directory dir laid out
+ *        as pb_reset.h. Without it (or if dir is not laid out) the script is used.
+ * @return 0, or -1 if dir cannot be used.
+ */
+int rst_open( const char *dir )
+{
+	char path[RST_PATH_LEN];
+	ssize_t n;
+
+	rst_on = 0;
+	snprintf(rst_dir, sizeof(rst_dir), "%s", dir);
+	n = readlink(rst_path(path, RST_CURRENT), rst_current, sizeof(rst_current) - 1);
+	if (n < 0)
+	{
+		printf("%s: %s - factory reset by script\n", path, strerror(errno));
+		return(-1);
+	}
+	rst_current[n] = '\0';
+	if (rst_generation(rst_current) < 0)
+	{
+		printf("%s -> %s: not a generation - factory reset by script\n", path, rst_current);
+		return(-1);
+	}
+	rst_on = 1;
+	printf("Factory reset: snapshot swap in %s (%s)\n", rst_dir, rst_current);
+	return(0);
+}
+
+/*
+ * rst_swap
+ *
+ * @brief Switches current to a new, empty generation - the factory reset, effective
+ *        on the next boot. The old data stays until rst_cleanup() after that boot.
+ * @return 0, or -1 if not in use or the swap failed (current is unchanged).
+ */
+int rst_swap( void )
+{
+	char path[RST_PATH_LEN], tmp[RST_PATH_LEN], name[RST_NAME_LEN];
+	char boot_id[RST_ID_LEN];
+	long n;
+	int fd;
+
+	if (!rst_on)
+		return(-1);
+
+	/* First free number - one left by an earlier swap may not be erased yet, and
+	   none listed for an erase, which may still be running */
+	n = rst_generation(rst_current);
+	if (rst_old_last > n)
+		n = rst_old_last;
+	for (n++; ; n++)
+	{
+		snprintf(name, sizeof(name), RST_GEN "%ld", n);
+		if (mkdir(rst_path(path, name), 0755) == 0)
+			break;
+		if (errno != EEXIST)
+		{
+			perror(path);
+			return(-1);
+		}
+	}
+	snprintf(tmp, sizeof(tmp), "%s/%s/upper", rst_dir, name);
+	if (mkdir(tmp, 0755) == -1)
+	{
+		perror(tmp);
+		return(-1);
+	}
+	snprintf(tmp, sizeof(tmp), "%s/%s/work", rst_dir, name);
+	if ((mkdir(tmp, 0755) == -1) || (rst_sync(path) == -1))
+	{
+		perror(tmp);
+		return(-1);
+	}
+
+	/* Until rebooted, the mounted generation is no longer current - keep it */
+	if (rst_read(RST_BOOT_ID, boot_id, sizeof(boot_id)) < 0)
+		strcpy(boot_id, "unknown");
+	fd = open(rst_path(path, RST_PENDING), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+	if ((fd == -1) || (write(fd, boot_id, strlen(boot_id)) == -1) || (fsync(fd) == -1))
+	{
+		perror(path);
+		if (fd != -1)
+			close(fd);
+		return(-1);
+	}
+	close(fd);
+	/* ... and their entries in the data directory */
+	if (rst_sync(rst_dir) == -1)
+	{
+		perror(rst_dir);
+		return(-1);
+	}
+
+	/* The swap - rename() replaces current atomically */
+	rst_path(tmp, RST_CURRENT ".tmp");
+	unlink(tmp);
+	if ((symlink(name, tmp) == -1) || (rename(tmp, rst_path(path, RST_CURRENT)) == -1))
+	{
+		perror(path);
+		unlink(tmp);
+		return(-1);
+	}
+	rst_sync(rst_dir);
+	printf("Factory reset: %s -> %s, effective on reboot\n", rst_current, name);
+	strcpy(rst_current, name);
+	return(0);
+}
+
+/*
+ * rst_cleanup
+ *
+ * @brief Erases the generations a factory reset has left, in a child at idle I/O
+ *        priority. Not until the swap has been booted into.
+ * @return 1 if erasing in the background (poll with rst_busy()), 0 if nothing to do,
+ *         -1 on failure.
+ */
+int rst_cleanup( void )
+{
+	char path[RST_PATH_LEN];
+	pid_t pid;
+
+	if (!rst_on || rst_pid)
+		return(0);
+	if (rst_pending())
+	{
+		printf("Factory reset: pending reboot - old data kept\n");
+		return(0);
+	}
+	unlink(rst_path(path, RST_PENDING));
+	if (rst_list() <= 0)
+		return(0);
+
+	/* Do not let the child flush our buffered output a second time */
+	fflush(NULL);
+	pid = fork();
+	if (pid == -1)
+	{
+		perror("fork");
+		return(-1);
+	}
+	if (pid == 0)
+	{
+		/* Idle - the erase only gets the disk when nothing else wants it */
+		iso_enter(FR_DEC_FACTORY_RESET, iso_ioprio("idle"));
+		rst_erase_old();
+		rst_sync(rst_dir);
+		fflush(stdout);
+		_exit(0);
+	}
+	rst_pid = pid;
+	printf("Factory reset: erasing old data in the background (pid %d)\n", (int)pid);
+	return(1);
+}
+
+/*
+ * rst_busy
+ *
+ * @brief Polls the background erase.
+ * @return 1 while it is running, 0 once finished (or none started).
+ */
+int rst_busy( void )
+{
+	int status;
+
+	if (rst_pid == 0)
+		return(0);
+	if (waitpid(rst_pid, &status, WNOHANG) == 0)
+		return(1);
+	rst_pid = 0;
+	printf("Factory reset: old data erased\n");
+	return(0);
+}
@@ -0,0 +1,45 @@
+/**********************************************************************************************************************
+*
+*   File:           pb_reset.h
+*
+*   Summary:        Factory reset by snapshot swap, old data erased in the background
+*
+*   Element:        IESv06
+*
+*   Platform:       Linux (overlayfs)
+*
+*   Description:  The writable data is an overlay upper directory chosen by a pointer, so a
+*                 factory reset is one atomic rename instead of a wipe. In the data directory:
+*
+*                   current -> gen.<n>              symlink, resolved by the boot-time mount
+*                   gen.<n>/upper, gen.<n>/work     overlay upper and work directories
+*                   pending                         boot id of a swap not yet booted into
+*
+*                 mounted early at boot, before anything writes the data:
+*
+*                   mount -t overlay overlay -o lowerdir=/rom,upperdir=/data/current/upper,
+*                         workdir=/data/current/work /mnt
+*
+*                 rst_swap() creates an empty gen.<n+1> and renames a new link over current,
+*                 so the next boot comes up on factory data whatever point power is lost at.
+*                 After that reboot rst_cleanup() erases the old generations in a child at
+*                 idle I/O priority (in the factory-reset cgroup when isolation is on).
+*
+*******************************************************************************************************************/
+#ifndef PB_RESET_H
+#define PB_RESET_H
+
+/*
+ * Defines
+ */
+#define RST_CURRENT         "current"
+#define RST_PENDING         "pending"
+#define RST_GEN             "gen."
+#define RST_BOOT_ID         "/proc/sys/kernel/random/boot_id"
+
+int  rst_open( const char *dir );
+int  rst_swap( void );
+int  rst_cleanup( void );
+int  rst_busy( void );
+
+#endif /* PB_RESET_H */
@@ -0,0 +1,72 @@
+/**********************************************************************************************************************
+*
+*   File:           pb_sdt.h
+*
+*   Summary:        Minimal systemtap SDT (USDT) probe notes, for toolchains without <sys/sdt.h>
+*
+*   Element:        IESv06
+*
+*   Platform:       Linux (GCC or clang; x86_64, i386, ARM, AArch64)
+*
+*   Description:  Emits the same version 3 .note.stapsdt entries as <sys/sdt.h>: a NOP at the
+*                 probe site, and a note naming provider, probe, and each argument as
+*                 "[-]size@operand", so perf, bpftrace and systemtap find the probes with no
+*                 special build. Only the DTRACE_PROBE1..3 used by pb_probes.h are provided,
+*                 for integer arguments, and there are no semaphores. On a 32-bit target a
+*                 64-bit argument is described by its low register only, as with <sys/sdt.h>.
+*
+*******************************************************************************************************************/
+#ifndef PB_SDT_H
+#define PB_SDT_H
+
+/*
+ * Defines
+ */
+#if defined(__LP64__)
+#define PB_SDT_ADDR         ".8byte"
+#else
+#define PB_SDT_ADDR         ".4byte"
+#endif
+
+/* %n prints the negated constant: -size for a signed argument, size for unsigned.
+   Signed if -1 converts below 1 - no unsigned < 0 test for -Wtype-limits */
+#define PB_SDT_SIZE(x)      (((__typeof__(x))-1 < (__typeof__(x))1) ? (int)sizeof(x) : -(int)sizeof(x))
+#define PB_SDT_ARG(n, x)    [pb_sdt_s##n] "n" (PB_SDT_SIZE(x)), [pb_sdt_a##n] "nor" (x)
+#define PB_SDT_FMT(n)       "%n[pb_sdt_s" #n "]@%[pb_sdt_a" #n "]"
+
+#define PB_SDT_PROBE(provider, name, args, ...)                                             \
+	__asm__ __volatile__ (                                                                  \
+		"990:\tnop\n"                                                                       \
+		"\t.pushsection .note.stapsdt,\"\",\"note\"\n"                                      \
+		"\t.balign 4\n"                                                                     \
+		"\t.4byte 992f-991f, 994f-993f, 3\n"                                                \
+		"991:\t.asciz \"stapsdt\"\n"                                                        \
+		"992:\t.balign 4\n"                                                                 \
+		"993:\t" PB_SDT_ADDR " 990b\n"                                                      \
+		"\t" PB_SDT_ADDR " _.stapsdt.base\n"                                                \
+		"\t" PB_SDT_ADDR " 0\n"                                                             \
+		"\t.asciz \"" #provider "\"\n"                                                      \
+		"\t.asciz \"" #name "\"\n"                                                          \
+		"\t.asciz \"" args "\"\n"                                                           \
+		"994:\t.balign 4\n"                                                                 \
+		"\t.popsection\n"                                                                   \
+		"\t.ifndef _.stapsdt.base\n"                                                        \
+		"\t.pushsection .stapsdt.base,\"aG\",\"progbits\",.stapsdt.base,comdat\n"          \
+		"\t.weak _.stapsdt.base\n"                                                          \
+		"\t.hidden _.stapsdt.base\n"                                                        \
+		"_.stapsdt.base:\t.space 1\n"                                                       \
+		"\t.size _.stapsdt.base, 1\n"                                                       \
+		"\t.popsection\n"                                                                   \
+		"\t.endif\n"                                                                        \
+		: : __VA_ARGS__)
+
+#define DTRACE_PROBE1(provider, name, a1)                                                   \
+	PB_SDT_PROBE(provider, name, PB_SDT_FMT(1), PB_SDT_ARG(1, a1))
+#define DTRACE_PROBE2(provider, name, a1, a2)                                               \
+	PB_SDT_PROBE(provider, name, PB_SDT_FMT(1) " " PB_SDT_FMT(2),                           \
+	             PB_SDT_ARG(1, a1), PB_SDT_ARG(2, a2))
+#define DTRACE_PROBE3(provider, name, a1, a2, a3)                                           \
+	PB_SDT_PROBE(provider, name, PB_SDT_FMT(1) " " PB_SDT_FMT(2) " " PB_SDT_FMT(3),        \
+	             PB_SDT_ARG(1, a1), PB_SDT_ARG(2, a2), PB_SDT_ARG(3, a3))
+
+#endif /* PB_SDT_H */
@@ -0,0 +1,203 @@
+/**********************************************************************************************************************
+*
+*   File:           pb_uring.c
+*
+*   Summary:        Minimal io_uring ring for the libpbmon reactor
+*
+*   Element:        IESv06
+*
+*   Platform:       Linux 5.6+
+*
+*   Description:  Single-threaded use only. The SQ and CQ share one mapping
+*                 (IORING_FEAT_SINGLE_MMAP, Linux 5.4+). CQEs are reaped from the mapping
+*                 without a system call; pb_uring_submit() is the only io_uring_enter,
+*                 except when the kernel has parked completions on its overflow list
+*                 (IORING_SQ_CQ_OVERFLOW) - those are only moved to the CQ by an enter.
+*
+*******************************************************************************************************************/
+
+#include <errno.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+
+#include "pb_uring.h"
+
+/*
+ **************  Functions  ****************
+ */
+
+/*
+ * pb_uring_init
+ *
+ * @brief Creates a ring with entries submission slots.
+ * @return 0 on success, -1 if io_uring is not available.
+ */
+int pb_uring_init( struct pb_uring *ring, unsigned int entries )
+{
+	struct io_uring_params p;
+	size_t sq_size, cq_size;
+	char *ptr;
+
+	memset(ring, 0, sizeof(*ring));
+	memset(&p, 0, sizeof(p));
+	ring->fd = syscall(__NR_io_uring_setup, entries, &p);
+	if (ring->fd == -1)
+	{
+		perror("io_uring_setup");
+		return(-1);
+	}
+	if (!(p.features & IORING_FEAT_SINGLE_MMAP))
+	{
+		printf("io_uring: kernel too old (no single mmap)\n");
+		close(ring->fd);
+		return(-1);
+	}
+
+	sq_size = p.sq_off.array + (p.sq_entries * sizeof(unsigned int));
+	cq_size = p.cq_off.cqes + (p.cq_entries * sizeof(struct io_uring_cqe));
+	ring->ring_size = (sq_size > cq_size) ? sq_size : cq_size;
+	ring->ring_ptr = mmap(NULL, ring->ring_size, PROT_READ | PROT_WRITE,
+	                      MAP_SHARED | MAP_POPULATE, ring->fd, IORING_OFF_SQ_RING);
+	if (ring->ring_ptr == MAP_FAILED)
+	{
+		perror("io_uring mmap");
+		ring->ring_ptr = NULL;
+		close(ring->fd);
+		return(-1);
+	}
+	ring->sqes_size = p.sq_entries * sizeof(struct io_uring_sqe);
+	ring->sqes = mmap(NULL, ring->sqes_size, PROT_READ | PROT_WRITE,
+	                  MAP_SHARED | MAP_POPULATE, ring->fd, IORING_OFF_SQES);
+	if (ring->sqes == MAP_FAILED)
+	{
+		perror("io_uring mmap sqes");
+		munmap(ring->ring_ptr, ring->ring_size);
+		ring->ring_ptr = NULL;
+		close(ring->fd);
+		return(-1);
+	}
+
+	ptr = ring->ring_ptr;
+	ring->sq_head  = (unsigned int *)(ptr + p.sq_off.head);
+	ring->sq_tail  = (unsigned int *)(ptr + p.sq_off.tail);
+	ring->sq_mask  = (unsigned int *)(ptr + p.sq_off.ring_mask);
+	ring->sq_array = (unsigned int *)(ptr + p.sq_off.array);
+	ring->sq_flags = (unsigned int *)(ptr + p.sq_off.flags);
+	ring->cq_head  = (unsigned int *)(ptr + p.cq_off.head);
+	ring->cq_tail  = (unsigned int *)(ptr + p.cq_off.tail);
+	ring->cq_mask  = (unsigned int *)(ptr + p.cq_off.ring_mask);
+	ring->cqes     = (struct io_uring_cqe *)(ptr + p.cq_off.cqes);
+	ring->sqe_tail = *ring->sq_tail;
+	return(0);
+}
+
+/*
+ * pb_uring_sqe
+ *
+ * @brief Returns a cleared SQE to fill in, or NULL if the SQ is full.
+ */
+struct io_uring_sqe *pb_uring_sqe( struct pb_uring *ring )
+{
+	unsigned int head = __atomic_load_n(ring->sq_head, __ATOMIC_ACQUIRE);
+	struct io_uring_sqe *sqe;
+	unsigned int index;
+
+	if (ring->sqe_tail - head > *ring->sq_mask)
+		return(NULL);
+	index = ring->sqe_tail & *ring->sq_mask;
+	sqe = &ring->sqes[index];
+	memset(sqe, 0, sizeof(*sqe));
+	ring->sq_array[index] = index;
+	ring->sqe_tail++;
+	return(sqe);
+}
+
+/*
+ * pb_uring_space
+ *
+ * @brief Returns the number of free SQ slots.
+ */
+unsigned int pb_uring_space( struct pb_uring *ring )
+{
+	return((*ring->sq_mask + 1) - (ring->sqe_tail - __atomic_load_n(ring->sq_head, __ATOMIC_ACQUIRE)));
+}
+
+/*
+ * pb_uring_submit
+ *
+ * @brief Publishes the SQEs handed out and submits them - one io_uring_enter.
+ * @return number submitted, or -1 on error.
+ */
+int pb_uring_submit( struct pb_uring *ring )
+{
+	unsigned int to_submit = ring->sqe_tail - *ring->sq_tail;
+	unsigned int flags = 0;
+	int ret;
+
+	/* Flush overflowed completions in the same call */
+	if (__atomic_load_n(ring->sq_flags, __ATOMIC_RELAXED) & IORING_SQ_CQ_OVERFLOW)
+		flags = IORING_ENTER_GETEVENTS;
+	if ((to_submit == 0) && (flags == 0))
+		return(0);
+	__atomic_store_n(ring->sq_tail, ring->sqe_tail, __ATOMIC_RELEASE);
+	do
+	{
+		ret = syscall(__NR_io_uring_enter, ring->fd, to_submit, 0, flags, NULL, 0);
+	} while ((ret == -1) && (errno == EINTR));
+	ring->enters++;
+	if (ret == -1)
+	{
+		perror("io_uring_enter");
+	}
+	return(ret);
+}
+
+/*
+ * pb_uring_cqe
+ *
+ * @brief Returns the next completion, or NULL if none. No system call unless
+ *        the CQ is empty and completions overflowed.
+ */
+struct io_uring_cqe *pb_uring_cqe( struct pb_uring *ring )
+{
+	unsigned int head = *ring->cq_head;
+
+	if ((head == __atomic_load_n(ring->cq_tail, __ATOMIC_ACQUIRE)) &&
+	    (__atomic_load_n(ring->sq_flags, __ATOMIC_RELAXED) & IORING_SQ_CQ_OVERFLOW))
+	{
+		syscall(__NR_io_uring_enter, ring->fd, 0, 0, IORING_ENTER_GETEVENTS, NULL, 0);
+		ring->enters++;
+	}
+	if (head == __atomic_load_n(ring->cq_tail, __ATOMIC_ACQUIRE))
+		return(NULL);
+	return(&ring->cqes[head & *ring->cq_mask]);
+}
+
+/*
+ * pb_uring_cqe_seen
+ *
+ * @brief Consumes the completion returned by pb_uring_cqe().
+ */
+void pb_uring_cqe_seen( struct pb_uring *ring )
+{
+	__atomic_store_n(ring->cq_head, *ring->cq_head + 1, __ATOMIC_RELEASE);
+}
+
+/*
+ * pb_uring_exit
+ *
+ * @brief Tears down the ring; outstanding requests are cancelled by the kernel.
+ */
+void pb_uring_exit( struct pb_uring *ring )
+{
+	if (ring->ring_ptr == NULL)
+		return;
+	munmap(ring->sqes, ring->sqes_size);
+	munmap(ring->ring_ptr, ring->ring_size);
+	ring->ring_ptr = NULL;
+	close(ring->fd);
+	ring->fd = -1;
+}
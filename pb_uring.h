@@ -0,0 +1,50 @@
+/**********************************************************************************************************************
+*
+*   File:           pb_uring.h
+*
+*   Summary:        Minimal io_uring ring for the libpbmon reactor
+*
+*   Element:        IESv06
+*
+*   Platform:       Linux 5.6+
+*
+*   Description:  Just enough of io_uring (setup, SQE get, submit, CQE reap) for pbmon.c,
+*                 using the kernel UAPI header directly so no liburing is needed.
+*
+*******************************************************************************************************************/
+#ifndef PB_URING_H
+#define PB_URING_H
+
+#include <linux/io_uring.h>
+
+/*
+ * Ring - SQ and CQ mappings
+ */
+struct pb_uring {
+	int                  fd;
+	unsigned int         *sq_head;
+	unsigned int         *sq_tail;
+	unsigned int         *sq_mask;
+	unsigned int         *sq_array;
+	unsigned int         *sq_flags;
+	struct io_uring_sqe  *sqes;
+	unsigned int         sqe_tail;          /* SQEs handed out, not yet published */
+	unsigned int         *cq_head;
+	unsigned int         *cq_tail;
+	unsigned int         *cq_mask;
+	struct io_uring_cqe  *cqes;
+	void                 *ring_ptr;
+	size_t               ring_size;
+	size_t               sqes_size;
+	unsigned long        enters;            /* io_uring_enter calls, for benchmarks */
+};
+
+int  pb_uring_init( struct pb_uring *ring, unsigned int entries );
+struct io_uring_sqe *pb_uring_sqe( struct pb_uring *ring );
+unsigned int pb_uring_space( struct pb_uring *ring );
+int  pb_uring_submit( struct pb_uring *ring );
+struct io_uring_cqe *pb_uring_cqe( struct pb_uring *ring );
+void pb_uring_cqe_seen( struct pb_uring *ring );
+void pb_uring_exit( struct pb_uring *ring );
+
+#endif /* PB_URING_H */
@@ -0,0 +1,942 @@
+/**********************************************************************************************************************
+*
+*   File:           pbmon.c
+*
+*   Summary:        libpbmon - embeddable push-button monitor
+*
+*   Element:        IESv06
+*
+*   Platform:       Linux
+*
+*   Description:  Owns the input device and the deadline scheduler's timerfd (pb_deadline.h).
+*                 Deadlines: Timer1 - end of the START-UP window, then a housekeeping
+*                 interval - and, while the button is held, the next LED threshold,
+*                 cancelled on release. Both fds are in one epoll set whose fd is handed to
+*                 the host, so a host loop waits on a single fd and each event costs no
+*                 context switch.
+*
+*                 pbmon_dispatch() reads whatever is ready, times presses, calls the host
+*                 callbacks and, unless the host handled a release, runs the default
+*                 action through pb_press.c.
+*
+*                 io_uring backend (pbmon_use_uring() before pbmon_init()): pbmon_fd() is
+*                 the ring fd. One read is kept armed on the device, linked to a
+*                 LINK_TIMEOUT at the earliest deadline, so no timerfd or epoll set is
+*                 needed. LED writes described by an ABI 2 LED plugin are queued as
+*                 ordered (hard-linked) writes and go in the same submission as the read
+*                 re-arm: each dispatch costs one io_uring_enter, and completions are
+*                 reaped from shared memory. Falls back to epoll if io_uring is unavailable.
+*
+*                 Command socket (pbmon_use_command() before pbmon_init(), pb_command.h):
+*                 virtual presses and direct action requests from local agents, served in
+*                 pbmon_dispatch() like the device. pbmon_inject() / pbmon_request() do the
+*                 same for a host without the socket.
+*
+*******************************************************************************************************************/
+
+#include <errno.h>
+#include <fcntl.h>
+#include <linux/input.h>
+#include <poll.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/epoll.h>
+#include <sys/ioctl.h>
+#include <sys/time.h>
+
+#include "pb_command.h"
+#include "pb_deadline.h"
+#include "pb_latency.h"
+#include "pb_plugin.h"
+#include "pb_press.h"
+#include "pb_probes.h"
+#include "pb_reset.h"
+#include "pb_uring.h"
+#include "pbmon.h"
+
+/*
+ * Defines
+ */
+#define DEVICE_RETRIES  50     /* open attempts, DEVICE_RETRY_US apart */
+#define DEVICE_RETRY_US 200000
+#define PB_KEY_CODE     256    /* BTN_0 from the GSC */
+#define PBMON_RING_SIZE 16
+#define PBMON_UD_READ   1      /* io_uring user_data: tag | fd << 8 */
+#define PBMON_UD_TIMEOUT 2
+#define PBMON_UD_WRITE  3
+#define PBMON_UD_POLL   4
+#define PBMON_UD_CANCEL 5
+#define PBMON_EVENTS    (CMD_CLIENTS + 3)
+
+/*
+ * Static
+ */
+static const char *pbmon_device;
+static struct pbmon_callbacks pbmon_cb;
+static int pbmon_epfd = -1;
+static int pbmon_input_fd = -1;
+static int pbmon_timer_fd = -1;
+
+/* push button timer press to release */
+static struct timespec timer_start;
+
+/* deadlines - Timer1 and the next LED threshold of a held press */
+static struct dl_timer pbmon_timer1;
+static struct dl_timer pbmon_threshold;
+static uint64_t timer_interval_ns;
+static uint64_t pbmon_press_ns;     /* CLOCK_MONOTONIC at press */
+
+/* io_uring backend */
+static int pbmon_uring_on;
+static struct pb_uring pbmon_ring;
+static struct input_event pbmon_ev[64];
+static int pbmon_read_armed;
+static uint64_t pbmon_armed_ns;     /* deadline of the armed read's linked timeout */
+static int pbmon_dispatching;
+static struct __kernel_timespec pbmon_link_ts;
+static struct io_uring_sqe *pbmon_last_write;
+
+/* command socket */
+static const char *pbmon_cmd_path;
+static gid_t pbmon_cmd_gid = CMD_NO_GROUP;
+static int pbmon_cmd_fd = -1;
+static int pbmon_cmd_clients[CMD_CLIENTS] = { -1, -1, -1, -1 };
+static int pbmon_virtual;      /* press in progress is a virtual one */
+static clockid_t pbmon_event_clock = CLOCK_REALTIME;   /* input_event timestamps */
+
+/*
+ **************  Functions  ****************
+ */
+static void pbmon_uring_flush( void );
+
+/*
+ * open_device
+ *
+ * @brief Opens the input device, waiting for it to become available, and has it
+ *        timestamp events on CLOCK_MONOTONIC.
+ * @return file descriptor, or -1 on failure.
+ */
+static int open_device( const char *device )
+{
+	/* io_uring waits for data itself - a non-blocking fd would complete with -EAGAIN */
+	int flags = O_RDONLY | O_CLOEXEC | (pbmon_uring_on ? 0 : O_NONBLOCK);
+	int clock = CLOCK_MONOTONIC;
+	int fd;
+	int count;
+
+	for (count = 0; count < DEVICE_RETRIES; count++)
+	{
+		if ((fd = open(device, flags)) >= 0)
+		{
+			/* Wake latency then survives clock steps; not an evdev (ENOTTY) - realtime */
+			if (ioctl(fd, EVIOCSCLOCKID, &clock) == 0)
+				pbmon_event_clock = CLOCK_MONOTONIC;
+			else
+			{
+				pbmon_event_clock = CLOCK_REALTIME;
+				if (errno != ENOTTY)
+					perror("EVIOCSCLOCKID");
+			}
+			return(fd);
+		}
+		usleep(DEVICE_RETRY_US);
+	}
+	perror(device);
+	return(-1);
+}
+
+/*
+ * timer_begin
+ *
+ * @brief Arms Timer1 for first period and constant interval timeouts.
+ *        The initial timer period allows switch between START-UP mode and INUSE mode.
+ * @return 0, or -1 on failure.
+ */
+static int timer_begin( int expireS, int intervalS )
+{
+	timer_interval_ns = (uint64_t)intervalS * 1000000000ULL;
+	return(dl_add(&pbmon_timer1, pb_time_ns(CLOCK_MONOTONIC) + ((uint64_t)expireS * 1000000000ULL)));
+}
+
+/*
+ * pbmon_uring_sqe
+ *
+ * @brief Returns an SQE, submitting what is queued first if the SQ is full.
+ */
+static struct io_uring_sqe *pbmon_uring_sqe( void )
+{
+	struct io_uring_sqe *sqe = pb_uring_sqe(&pbmon_ring);
+
+	if (sqe == NULL)
+	{
+		pb_uring_submit(&pbmon_ring);
+		pbmon_last_write = NULL;
+		sqe = pb_uring_sqe(&pbmon_ring);
+	}
+	return(sqe);
+}
+
+/*
+ * pbmon_watch
+ *
+ * @brief Adds fd to the epoll set, or with io_uring queues a one-shot poll for it
+ *        (re-armed by calling again once handled).
+ */
+static int pbmon_watch( int fd )
+{
+	struct epoll_event ee;
+	struct io_uring_sqe *sqe;
+
+	if (pbmon_uring_on)
+	{
+		if ((sqe = pbmon_uring_sqe()) == NULL)
+			return(-1);
+		sqe->opcode = IORING_OP_POLL_ADD;
+		sqe->fd = fd;
+		sqe->poll32_events = POLLIN;
+		sqe->user_data = ((uint64_t)fd << 8) | PBMON_UD_POLL;
+		pbmon_last_write = NULL;
+		return(0);
+	}
+	ee.events = EPOLLIN;
+	ee.data.fd = fd;
+	if (epoll_ctl(pbmon_epfd, EPOLL_CTL_ADD, fd, &ee) == -1)
+	{
+		perror("epoll_ctl");
+		return(-1);
+	}
+	return(0);
+}
+
+/*
+ * pbmon_timer_expired
+ *
+ * @brief Timer1 deadline, late_ns after it (overshoot recorded by the scheduler).
+ *        Re-arms at the next interval not yet passed. On first entry changes to IN-USE mode.
+ */
+static void pbmon_timer_expired( struct dl_timer *timer, uint64_t late_ns )
+{
+	char cmd[PB_SYS_CALL_LEN];
+
+	dl_add(timer, timer->deadline_ns + (timer_interval_ns * (1 + (late_ns / timer_interval_ns))));
+
+	/* Factory reset's old data erased - back to the heartbeat */
+	if ((pb_led_idle == LED_GREEN) && !rst_busy())
+	{
+		pb_led_idle = LED_FLASH_GREEN;
+		if ((pb_press_state == PB_STATE_INUSE) && !timer_start.tv_sec)
+			pb_set_led(pb_led_idle);
+	}
+
+	/* On First entry Change state */
+	if (pb_press_state == PB_STATE_START)
+	{
+		printf("Timer1 - Changes pb mode to in-use\n");
+		pb_press_state = PB_STATE_INUSE;
+		pb_set_led(pb_led_idle);
+		/* Must call check-factory-reset.sh wthout causing facory reset */
+		snprintf(cmd, sizeof(cmd), "%s 0", pb_sys_call_check_factory_reset);
+		/* Call check-factory-reset.sh to perform a factory reset */
+		pb_run_action(cmd, FR_DEC_NONE);
+	}
+}
+
+/*
+ * pbmon_held
+ *
+ * @brief Re-evaluates a held press for LED changes. The time held is on the
+ *        deadlines' clock (CLOCK_MONOTONIC), so a wall clock slewed or stepped by
+ *        NTP cannot put a threshold's deadline short of its level.
+ * @return seconds held.
+ */
+static unsigned long pbmon_held( void )
+{
+	unsigned long level, seconds;
+
+	/* Process the time so far to determine LED changes */
+	seconds = (pb_time_ns(CLOCK_MONOTONIC) - pbmon_press_ns) / 1000000000ULL;
+	if (seconds)
+	{
+		level = pb_threshold_level;
+		pb_process_time(seconds);
+		if ((pb_threshold_level != level) && pb_threshold_level && pbmon_cb.threshold)
+			pbmon_cb.threshold(pbmon_cb.ctx, pb_press_state, pb_threshold_level);
+	}
+	return(seconds);
+}
+
+/*
+ * pbmon_threshold_due
+ *
+ * @brief Held press reached an LED threshold - re-evaluates it and arms the next one.
+ */
+static void pbmon_threshold_due( struct dl_timer *timer, uint64_t late_ns )
+{
+	unsigned long next;
+
+	next = pb_next_threshold(pbmon_held());
+	if (next)
+		dl_add(timer, pbmon_press_ns + ((uint64_t)next * 1000000000ULL));
+}
+
+/*
+ * pbmon_key
+ *
+ * @brief Push-button press (value 1) or release (value 0).
+ */
+static void pbmon_key( const struct input_event *ev )
+{
+	struct timespec timer_stop, time_duration;
+	unsigned long press_ms;
+	double total_time;
+	int handled = 0;
+
+	/* PUSH Button */
+	if (ev->value == 1)
+	{
+		/* start timer */
+		if ((clock_gettime(CLOCK_REALTIME, &timer_start)) == -1)
+		{
+			perror("clock gettime");
+			return;
+		}
+		/* LED changes exactly at each threshold */
+		pbmon_press_ns = pb_time_ns(CLOCK_MONOTONIC);
+		dl_add(&pbmon_threshold, pbmon_press_ns + ((uint64_t)pb_next_threshold(0) * 1000000000ULL));
+		fr_record(FR_PRESS, pb_press_state, pbmon_virtual);
+		PB_PROBE2(press_start, pb_press_state,
+		          ((uint64_t)ev->time.tv_sec * 1000000000ULL) + (ev->time.tv_usec * 1000ULL));
+		if (pbmon_cb.press)
+			pbmon_cb.press(pbmon_cb.ctx, pb_press_state);
+	}
+	/* RELEASE Button */
+	else if (ev->value == 0)
+	{
+		dl_cancel(&pbmon_threshold);
+		total_time = pb_test_time( &timer_start, &timer_stop, &time_duration);
+		if (!total_time)
+		{
+			printf("Invalid Time\n");
+			return;
+		}
+		press_ms = (unsigned long)(total_time * 1000);
+		fr_record(FR_RELEASE, pb_press_state, press_ms);
+		PB_PROBE2(release, pb_press_state, press_ms);
+		if (pbmon_cb.release)
+			handled = pbmon_cb.release(pbmon_cb.ctx, pb_press_state, press_ms,
+			                           pb_classify_press((unsigned long)total_time));
+		/* Call Function to perform actions */
+		if (!handled)
+			pb_process_end_time((unsigned long)total_time);
+		/* Reset */
+		timer_start.tv_sec = 0;
+		timer_start.tv_nsec = 0;
+		pb_threshold_level = 0;
+		pbmon_virtual = 0;
+		pb_set_led(pb_led_idle);
+	}
+}
+
+/*
+ * pbmon_inject
+ *
+ * @brief Virtual button press (value 1) or release (0) - timed and classified as a
+ *        real one. A release only ends a virtual press.
+ * @return 0, or -1 if the button is not in the right state.
+ */
+int pbmon_inject( int value )
+{
+	struct input_event ev;
+
+	if ((value && timer_start.tv_sec) || (!value && !pbmon_virtual))
+		return(-1);
+	memset(&ev, 0, sizeof(ev));
+	gettimeofday(&ev.time, NULL);
+	ev.type = EV_KEY;
+	ev.code = PB_KEY_CODE;
+	ev.value = value;
+	if (value)
+		pbmon_virtual = 1;
+	pbmon_key(&ev);
+	/* Called by the host - submit the LED writes and any earlier deadline now */
+	if (pbmon_uring_on && !pbmon_dispatching)
+		pbmon_uring_flush();
+	return(0);
+}
+
+/*
+ * pbmon_request
+ *
+ * @brief Carries out decision (enum fr_decision) as if a press had been classified
+ *        so. Factory reset now is only valid in the START-UP window.
+ * @return 0, or -1 if refused (button held, or wrong mode).
+ */
+int pbmon_request( unsigned int decision )
+{
+	if (timer_start.tv_sec || ((decision == FR_DEC_FACTORY_RESET) && (pb_press_state != PB_STATE_START)))
+		return(-1);
+	pb_process_decision(decision);
+	pb_set_led(pb_led_idle);
+	if (pbmon_uring_on && !pbmon_dispatching)
+		pbmon_uring_flush();
+	return(0);
+}
+
+/*
+ * pbmon_command
+ *
+ * @brief Carries out a command from the socket. The reply goes first, so the
+ *        agent is answered before a reboot or shutdown starts.
+ */
+static void pbmon_command( int fd, const struct cmd *cmd )
+{
+	char reply[CMD_LEN];
+
+	switch (cmd->op)
+	{
+	case CMD_PRESS:
+		if (timer_start.tv_sec)
+		{
+			cmd_reply(fd, "error pressed");
+			break;
+		}
+		cmd_reply(fd, "ok");
+		pbmon_inject(1);
+		break;
+
+	case CMD_RELEASE:
+		if (!pbmon_virtual)
+		{
+			cmd_reply(fd, "error no virtual press");
+			break;
+		}
+		cmd_reply(fd, "ok");
+		pbmon_inject(0);
+		break;
+
+	case CMD_ACTION:
+		if (timer_start.tv_sec)
+			cmd_reply(fd, "error pressed");
+		else if ((cmd->decision == FR_DEC_FACTORY_RESET) && (pb_press_state != PB_STATE_START))
+			cmd_reply(fd, "error not in start-up window");
+		else
+		{
+			cmd_reply(fd, "ok");
+			pbmon_request(cmd->decision);
+		}
+		break;
+
+	case CMD_STATE:
+		snprintf(reply, sizeof(reply), "ok %s %s", (pb_press_state == PB_STATE_START) ? "start" : "in-use",
+		         timer_start.tv_sec ? "pressed" : "released");
+		cmd_reply(fd, reply);
+		break;
+	}
+}
+
+/*
+ * pbmon_command_ready
+ *
+ * @brief The command socket or a connection is readable.
+ */
+static void pbmon_command_ready( int fd )
+{
+	struct cmd cmd;
+	int i, client, ret;
+
+	if (fd == pbmon_cmd_fd)
+	{
+		while ((client = cmd_accept(pbmon_cmd_fd, pbmon_cmd_gid)) != -1)
+		{
+			for (i = 0; (i < CMD_CLIENTS) && (pbmon_cmd_clients[i] != -1); i++)
+				;
+			if ((i == CMD_CLIENTS) || (pbmon_watch(client) < 0))
+			{
+				cmd_reply(client, "error busy");
+				close(client);
+				continue;
+			}
+			pbmon_cmd_clients[i] = client;
+		}
+		if (pbmon_uring_on)
+			pbmon_watch(pbmon_cmd_fd);
+		return;
+	}
+
+	while ((ret = cmd_receive(fd, &cmd)) > 0)
+		pbmon_command(fd, &cmd);
+	if (ret < 0)
+	{
+		/* Closing also removes it from the epoll set */
+		for (i = 0; i < CMD_CLIENTS; i++)
+		{
+			if (pbmon_cmd_clients[i] == fd)
+				pbmon_cmd_clients[i] = -1;
+		}
+		close(fd);
+	}
+	else if (pbmon_uring_on)
+	{
+		pbmon_watch(fd);
+	}
+}
+
+/*
+ * pbmon_is_command
+ *
+ * @brief Is fd the command socket or one of its connections.
+ */
+static int pbmon_is_command( int fd )
+{
+	int i;
+
+	if (fd == pbmon_cmd_fd)
+		return(1);
+	for (i = 0; i < CMD_CLIENTS; i++)
+	{
+		if (pbmon_cmd_clients[i] == fd)
+			return(1);
+	}
+	return(0);
+}
+
+/*
+ * pbmon_reopen
+ *
+ * @brief Device gone - reopen rather than spin on the error.
+ * @return 0, or -1 if it could not be reopened.
+ */
+static int pbmon_reopen( void )
+{
+	close(pbmon_input_fd);
+	if ((pbmon_input_fd = open_device(pbmon_device)) < 0)
+		return(-1);
+	if (!pbmon_uring_on && (pbmon_watch(pbmon_input_fd) < 0))
+		return(-1);
+	return(0);
+}
+
+/*
+ * pbmon_events
+ *
+ * @brief Processes rd bytes of input events.
+ */
+static void pbmon_events( const struct input_event *ev, int rd )
+{
+	uint64_t event_ns, handled_ns;
+	size_t i, n;
+
+	if (rd <= 0)
+		return;
+	n = (size_t)rd / sizeof(struct input_event);
+	handled_ns = pb_time_ns(pbmon_event_clock);
+	PB_PROBE3(event_read, n,
+	          ((uint64_t)ev[0].time.tv_sec * 1000000000ULL) + (ev[0].time.tv_usec * 1000ULL),
+	          handled_ns);
+	for (i = 0; i < n; i++)
+	{
+		if (ev[i].type != EV_KEY)
+			continue;
+		/* Kernel event time to now, both on pbmon_event_clock */
+		event_ns = ((uint64_t)ev[i].time.tv_sec * 1000000000ULL) + (ev[i].time.tv_usec * 1000ULL);
+		if (handled_ns > event_ns)
+		{
+			lat_record(&lat_wake, (handled_ns - event_ns) / 1000);
+		}
+		if (ev[i].code == PB_KEY_CODE)
+		{
+			/* The real button takes over from a virtual press (not on auto-repeat) */
+			if (ev[i].value != 2)
+				pbmon_virtual = 0;
+			pbmon_key(&ev[i]);
+		}
+	}
+}
+
+/*
+ * pbmon_input
+ *
+ * @brief Reads and processes the pending input events.
+ * @return 0, or -1 if the device failed and could not be reopened.
+ */
+static int pbmon_input( void )
+{
+	struct input_event ev[64];
+	int rd;
+
+	rd = read(pbmon_input_fd, ev, sizeof(ev));
+	if (rd < (int) sizeof(struct input_event))
+	{
+		if ((rd < 0) && (errno != EINTR) && (errno != EAGAIN))
+		{
+			perror("read error");
+			return(pbmon_reopen());
+		}
+		return(0);
+	}
+	pbmon_events(ev, rd);
+	return(0);
+}
+
+/*
+ * pbmon_queue_write
+ *
+ * @brief LED plugin write queue - adds the write to the next submission, hard-linked
+ *        after the previous queued write so writes apply in order.
+ * @return 0, or -1 if the ring is full.
+ */
+static int pbmon_queue_write( const struct pb_plugin_write *write )
+{
+	struct io_uring_sqe *sqe = pbmon_uring_sqe();
+
+	if (sqe == NULL)
+		return(-1);
+	sqe->opcode = IORING_OP_WRITE;
+	sqe->fd = write->fd;
+	sqe->addr = (uintptr_t)write->data;
+	sqe->len = write->len;
+	sqe->off = 0;
+	sqe->user_data = PBMON_UD_WRITE;
+	if (pbmon_last_write != NULL)
+		pbmon_last_write->flags |= IOSQE_IO_HARDLINK;
+	pbmon_last_write = sqe;
+	return(0);
+}
+
+/*
+ * pbmon_uring_arm
+ *
+ * @brief Queues the device read, linked to a timeout at the earliest deadline. If a
+ *        deadline earlier than the armed timeout was added, cancels the read instead -
+ *        it is re-armed when the cancellation completes.
+ */
+static void pbmon_uring_arm( void )
+{
+	struct io_uring_sqe *read_sqe, *timeout_sqe, *sqe;
+	uint64_t now, next, wait_ns;
+
+	next = dl_next();
+	if (pbmon_read_armed)
+	{
+		if (next && (next < pbmon_armed_ns) && ((sqe = pbmon_uring_sqe()) != NULL))
+		{
+			sqe->opcode = IORING_OP_ASYNC_CANCEL;
+			sqe->fd = -1;
+			sqe->addr = PBMON_UD_READ;
+			sqe->user_data = PBMON_UD_CANCEL;
+			pbmon_last_write = NULL;
+			pbmon_armed_ns = next;
+		}
+		return;
+	}
+	/* Both SQEs must go in the same submission */
+	if (pb_uring_space(&pbmon_ring) < 2)
+		pb_uring_submit(&pbmon_ring);
+	read_sqe = pb_uring_sqe(&pbmon_ring);
+	timeout_sqe = pb_uring_sqe(&pbmon_ring);
+	pbmon_last_write = NULL;
+	if ((read_sqe == NULL) || (timeout_sqe == NULL))
+		return;
+
+	read_sqe->opcode = IORING_OP_READ;
+	read_sqe->fd = pbmon_input_fd;
+	read_sqe->addr = (uintptr_t)pbmon_ev;
+	read_sqe->len = sizeof(pbmon_ev);
+	read_sqe->off = (uint64_t)-1;           /* current position */
+	read_sqe->flags = IOSQE_IO_LINK;
+	read_sqe->user_data = PBMON_UD_READ;
+
+	now = pb_time_ns(CLOCK_MONOTONIC);
+	if (next == 0)
+		next = now + timer_interval_ns;
+	wait_ns = (next > now) ? next - now : 1;
+	pbmon_armed_ns = next;
+	pbmon_link_ts.tv_sec = wait_ns / 1000000000ULL;
+	pbmon_link_ts.tv_nsec = wait_ns % 1000000000ULL;
+	timeout_sqe->opcode = IORING_OP_LINK_TIMEOUT;
+	timeout_sqe->addr = (uintptr_t)&pbmon_link_ts;
+	timeout_sqe->len = 1;
+	timeout_sqe->user_data = PBMON_UD_TIMEOUT;
+	pbmon_read_armed = 1;
+}
+
+/*
+ * pbmon_uring_flush
+ *
+ * @brief Re-arms the read and submits it with the queued LED writes - one io_uring_enter.
+ */
+static void pbmon_uring_flush( void )
+{
+	pbmon_uring_arm();
+	pb_uring_submit(&pbmon_ring);
+	pbmon_last_write = NULL;
+}
+
+/*
+ * pbmon_uring_reap
+ *
+ * @brief Processes completions - no system call.
+ * @return 0, or -1 if the input device failed and could not be reopened.
+ */
+static int pbmon_uring_reap( void )
+{
+	struct io_uring_cqe *cqe;
+	uint64_t user_data;
+	int res;
+
+	while ((cqe = pb_uring_cqe(&pbmon_ring)) != NULL)
+	{
+		user_data = cqe->user_data;
+		res = cqe->res;
+		pb_uring_cqe_seen(&pbmon_ring);
+
+		switch (user_data & 0xff)
+		{
+		case PBMON_UD_READ:
+			pbmon_read_armed = 0;
+			if (res >= (int) sizeof(struct input_event))
+			{
+				pbmon_events(pbmon_ev, res);
+			}
+			else if ((res < 0) && (res != -ECANCELED) && (res != -EINTR) && (res != -EAGAIN))
+			{
+				printf("read error: %s\n", strerror(-res));
+				if (pbmon_reopen() < 0)
+					return(-1);
+			}
+			break;
+
+		case PBMON_UD_WRITE:
+			if (res < 0)
+				printf("LED write: %s\n", strerror(-res));
+			break;
+
+		case PBMON_UD_POLL:
+			pbmon_command_ready((int)(user_data >> 8));
+			break;
+		}
+	}
+	return(0);
+}
+
+/*
+ * pbmon_init
+ *
+ * @brief Opens the device, disables the GSC hardware reset, reports the previous boot's
+ *        decisions and starts the START-UP window (or the factory reset requested in use).
+ * @param device    - input device, e.g. /dev/input/event0
+ * @param callbacks - host callbacks, or NULL
+ * @return 0 on success, -1 on failure.
+ */
+int pbmon_init( const char *device, const struct pbmon_callbacks *callbacks )
+{
+	int time_start;
+
+	pbmon_device = device;
+	if (callbacks)
+		pbmon_cb = *callbacks;
+	pb_press_state = PB_STATE_START;
+	timer_start.tv_sec = 0;
+	timer_start.tv_nsec = 0;
+
+	if (pbmon_uring_on && (pb_uring_init(&pbmon_ring, PBMON_RING_SIZE) < 0))
+	{
+		printf("io_uring not available - using epoll\n");
+		pbmon_uring_on = 0;
+	}
+	if (pbmon_uring_on)
+	{
+		pbmon_read_armed = 0;
+		pbmon_last_write = NULL;
+		pb_plugin_set_write_queue(pbmon_queue_write);
+	}
+	else if ((pbmon_epfd = epoll_create1(EPOLL_CLOEXEC)) == -1)
+	{
+		perror("epoll_create1");
+		return(-1);
+	}
+	/* Wait for interface to become available */
+	if (((pbmon_input_fd = open_device(device)) < 0) ||
+	    (!pbmon_uring_on && (pbmon_watch(pbmon_input_fd) < 0)))
+	{
+		pbmon_close();
+		return(-1);
+	}
+
+	// initialise
+	pb_initialise();
+
+	printf("Start Push-Button Monitor\n");
+	/* Report why the previous boot ended and start recording this one */
+	fr_open(FR_FILE);
+	printf("Start-Mode, press push-button for factory Reset\n");
+
+	/* Is there a file indicating factory-reset required on next boot */
+	pb_check_inuse_factory_reset( &time_start );
+
+	/* Optional - the button works without it */
+	if ((pbmon_cmd_path != NULL) && ((pbmon_cmd_fd = cmd_open(pbmon_cmd_path, pbmon_cmd_gid)) != -1) &&
+	    (pbmon_watch(pbmon_cmd_fd) < 0))
+	{
+		cmd_close(pbmon_cmd_path, pbmon_cmd_fd);
+		pbmon_cmd_fd = -1;
+	}
+
+	dl_timer_init(&pbmon_timer1, pbmon_timer_expired, NULL);
+	dl_timer_init(&pbmon_threshold, pbmon_threshold_due, NULL);
+	if (pbmon_uring_on)
+	{
+		timer_begin(time_start, TIMER1_INTERVAL);
+		pbmon_uring_flush();
+		return(0);
+	}
+	if (((pbmon_timer_fd = dl_open()) < 0) || (pbmon_watch(pbmon_timer_fd) < 0) ||
+	    (timer_begin(time_start, TIMER1_INTERVAL) < 0))
+	{
+		pbmon_close();
+		return(-1);
+	}
+	return(0);
+}
+
+/*
+ * pbmon_use_uring
+ *
+ * @brief Selects the io_uring backend (enable non-zero) - call before pbmon_init().
+ */
+void pbmon_use_uring( int enable )
+{
+	pbmon_uring_on = enable;
+}
+
+/*
+ * pbmon_use_command
+ *
+ * @brief Serves the command socket at path (pb_command.h), also open to group gid
+ *        unless CMD_NO_GROUP - call before pbmon_init().
+ */
+void pbmon_use_command( const char *path, gid_t gid )
+{
+	pbmon_cmd_path = path;
+	pbmon_cmd_gid = gid;
+}
+
+/*
+ * pbmon_uring_enters
+ *
+ * @brief io_uring_enter calls made so far by the io_uring backend (benchmarks).
+ */
+unsigned long pbmon_uring_enters( void )
+{
+	return(pbmon_ring.enters);
+}
+
+/*
+ * pbmon_fd
+ *
+ * @brief File descriptor for the host loop - readable when pbmon_dispatch() has work.
+ */
+int pbmon_fd( void )
+{
+	return(pbmon_uring_on ? pbmon_ring.fd : pbmon_epfd);
+}
+
+/*
+ * pbmon_dispatch
+ *
+ * @brief Handles everything ready on pbmon_fd() without blocking, including the
+ *        deadlines due (Timer1, LED thresholds of a held press).
+ * @return 0, or -1 if the input device failed and could not be reopened.
+ */
+int pbmon_dispatch( void )
+{
+	struct epoll_event ee[PBMON_EVENTS];
+	uint64_t expirations;
+	int i, n;
+
+	pbmon_dispatching = 1;
+	if (pbmon_uring_on)
+	{
+		if (pbmon_uring_reap() < 0)
+		{
+			pbmon_dispatching = 0;
+			return(-1);
+		}
+		/* The earliest deadline is the read's linked timeout - fire what is due */
+		dl_expire(pb_time_ns(CLOCK_MONOTONIC));
+	}
+	else
+	{
+		n = epoll_wait(pbmon_epfd, ee, PBMON_EVENTS, 0);
+		for (i = 0; i < n; i++)
+		{
+			if (ee[i].data.fd == pbmon_timer_fd)
+			{
+				if (read(pbmon_timer_fd, &expirations, sizeof(expirations)) == sizeof(expirations))
+					dl_expire(pb_time_ns(CLOCK_MONOTONIC));
+			}
+			else if (pbmon_is_command(ee[i].data.fd))
+			{
+				pbmon_command_ready(ee[i].data.fd);
+			}
+			else if (pbmon_input() < 0)
+			{
+				pbmon_dispatching = 0;
+				return(-1);
+			}
+		}
+	}
+
+	pbmon_dispatching = 0;
+	/* LED writes queued above and the read re-arm - one io_uring_enter */
+	if (pbmon_uring_on)
+		pbmon_uring_flush();
+	return(0);
+}
+
+/*
+ * pbmon_close
+ *
+ * @brief Releases the device, timer and command socket, unloads plugins and flushes the
+ *        flight recorder.
+ */
+void pbmon_close( void )
+{
+	int i;
+
+	for (i = 0; i < CMD_CLIENTS; i++)
+	{
+		if (pbmon_cmd_clients[i] != -1)
+		{
+			close(pbmon_cmd_clients[i]);
+			pbmon_cmd_clients[i] = -1;
+		}
+	}
+	cmd_close(pbmon_cmd_path, pbmon_cmd_fd);
+	pbmon_cmd_fd = -1;
+	if (pbmon_input_fd != -1)
+	{
+		close(pbmon_input_fd);
+		pbmon_input_fd = -1;
+	}
+	/* Drops the deadlines, closes the timerfd */
+	dl_close();
+	pbmon_timer_fd = -1;
+	if (pbmon_epfd != -1)
+	{
+		close(pbmon_epfd);
+		pbmon_epfd = -1;
+	}
+	if (pbmon_uring_on)
+	{
+		/* Last LED writes, then the ring; the pending read is cancelled */
+		pb_uring_submit(&pbmon_ring);
+		pb_plugin_set_write_queue(NULL);
+		pb_uring_exit(&pbmon_ring);
+	}
+	pb_plugin_unload();
+	fr_close();
+}
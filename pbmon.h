@@ -0,0 +1,67 @@
+/**********************************************************************************************************************
+*
+*   File:           pbmon.h
+*
+*   Summary:        libpbmon - embeddable push-button monitor
+*
+*   Element:        IESv06
+*
+*   Platform:       Linux
+*
+*   Description:  Device handling, press timing and classification of pb_monitor as a library,
+*                 for hosting in another daemon's event loop:
+*
+*                   pbmon_init(device, &callbacks);
+*                   add pbmon_fd() to the host loop for readability;
+*                   call pbmon_dispatch() whenever it is readable;
+*                   pbmon_close() on exit.
+*
+*                 Callbacks run in the host's thread from pbmon_dispatch(). No signals
+*                 are used. One monitor per process.
+*
+*                 pbmon_use_uring(1) before pbmon_init() selects the io_uring reactor;
+*                 pbmon_use_command() adds the local command socket (pb_command.h).
+*                 pbmon_inject() / pbmon_request() are virtual presses and direct action
+*                 requests for the host itself.
+*
+*******************************************************************************************************************/
+#ifndef PBMON_H
+#define PBMON_H
+
+#include <sys/types.h>
+
+#include "pb_flightrec.h"      /* enum fr_decision */
+
+/*
+ * Enum type declaration
+ */
+enum pb_state {
+	PB_STATE_START,
+	PB_STATE_INUSE
+};
+
+/*
+ * Callbacks - any may be NULL
+ */
+struct pbmon_callbacks {
+	/* Button pressed */
+	void (*press)( void *ctx, enum pb_state state );
+	/* Press held past a threshold - level_s is 5, 10 or 15 */
+	void (*threshold)( void *ctx, enum pb_state state, unsigned long level_s );
+	/* Button released - return non-zero if the host handled decision itself,
+	 * zero for the default action (reboot, shutdown, factory reset...) */
+	int  (*release)( void *ctx, enum pb_state state, unsigned long press_ms, unsigned int decision );
+	void *ctx;
+};
+
+void pbmon_use_uring( int enable );
+void pbmon_use_command( const char *path, gid_t gid );
+int  pbmon_init( const char *device, const struct pbmon_callbacks *callbacks );
+int  pbmon_fd( void );
+int  pbmon_dispatch( void );
+void pbmon_close( void );
+int  pbmon_inject( int value );
+int  pbmon_request( unsigned int decision );
+unsigned long pbmon_uring_enters( void );
+
+#endif /* PBMON_H */
@@ -26,29 +26,98 @@ CC=$(CROSS_COMPILE)gcc
 
 IDIR   = -Iinclude
 
+AR=$(CROSS_COMPILE)ar
+
+# libpbmon - device handling, timing and classification, embeddable (pbmon.h)
+LIB_SOURCES := pbmon.c pb_press.c pb_plugin.c pb_flightrec.c pb_latency.c pb_liveness.c pb_uring.c pb_command.c pb_isolate.c pb_reset.c pb_deadline.c pb_gsc.c
+LIB_OBJECTS = $(LIB_SOURCES:.c=.o)
+LIBRARY = libpbmon.a
+
 SOURCES := pb_monitor.c
 OBJECTS=$(SOURCES:.c=.o)
 
 EXECUTABLES=pb_monitor
 
+# In-process plugins (pb_plugin.h), loaded with pb_monitor -P
+PLUGINS = plugins/led_sysfs.so
+
 CFLAGS  += $(IDIR)
-LIB    =  -lrt
+LIB    =  -lrt -ldl
 LDFLAGS += -Wall
 
 #all: $(SOURCES) $(EXECUTABLES)
 
-$(EXECUTABLES): $(OBJECTS)
+$(EXECUTABLES): $(OBJECTS) $(LIBRARY)
 	@echo Linking - $(CC) $<
-	$(CC) $(LDFLAGS) $(LIB) $(OBJECTS) -o $@
+	$(CC) $(LDFLAGS) $(OBJECTS) $(LIBRARY) $(LIB) -o $@
 	chmod a+x $(EXECUTABLES)
 	$(CP) -a $(EXECUTABLES) $(PLATFORM_INSTALL_DIR)
 
+plugins: $(PLUGINS)
+	$(CP) -a $(PLUGINS) $(PLATFORM_INSTALL_DIR)
+
+plugins/%.so: plugins/%.c
+	@echo Plugin - $(CC) $<
+	$(CC) $(CFLAGS) -fPIC -shared $< -o $@
+
+$(LIBRARY): $(LIB_OBJECTS)
+	@echo Archiving - $(AR) $@
+	$(AR) rcs $@ $(LIB_OBJECTS)
+
 %.o: %.c
 	@echo Compiling - $(CC) $<
 	$(CC) -c $(CFLAGS) $< -o $@
 
-.PHONY: all pb_monitor
+# Host-side unit tests and benchmarks of the press core, side effects stubbed
+HOSTCC      ?= gcc
+HOSTCFLAGS  ?= -O2 -Wall
+TEST_DIR     = tests
+CORE_SOURCES = pb_press.c pb_plugin.c pb_flightrec.c pb_latency.c pb_liveness.c pb_isolate.c pb_reset.c pb_deadline.c pb_gsc.c
+STUB_SOURCES = $(TEST_DIR)/pb_stubs.c
+STUB_WRAP    = -Wl,--wrap=system,--wrap=fopen,--wrap=malloc,--wrap=calloc,--wrap=realloc
+# Whole library (reactor, command socket), flight recorder and GSC I2C disabled
+REACTOR_SOURCES = pbmon.c pb_uring.c pb_command.c $(CORE_SOURCES)
+REACTOR_WRAP    = $(STUB_WRAP),--wrap=fr_open,--wrap=gsc_open
+# Stub plugin for each ABI version around the accepted range (tests/plugin_stub.c)
+TEST_PLUGINS    = $(TEST_DIR)/plugin_abi0.so $(TEST_DIR)/plugin_abi1.so $(TEST_DIR)/plugin_abi2.so $(TEST_DIR)/plugin_abi3.so
+
+test: $(TEST_DIR)/test_press $(TEST_DIR)/test_command $(TEST_DIR)/test_isolate $(TEST_DIR)/test_reset $(TEST_DIR)/test_deadline $(TEST_DIR)/test_gsc $(TEST_DIR)/test_flightrec $(TEST_DIR)/test_plugin $(TEST_PLUGINS)
+	./$(TEST_DIR)/test_press
+	./$(TEST_DIR)/test_command
+	./$(TEST_DIR)/test_isolate
+	./$(TEST_DIR)/test_reset
+	./$(TEST_DIR)/test_deadline
+	./$(TEST_DIR)/test_gsc
+	./$(TEST_DIR)/test_flightrec
+	./$(TEST_DIR)/test_plugin
+
+bench: $(TEST_DIR)/bench_press $(TEST_DIR)/bench_reactor $(TEST_DIR)/led_sysfs.so
+	./$(TEST_DIR)/bench_press
+	./$(TEST_DIR)/bench_reactor
+
+$(TEST_DIR)/bench_reactor $(TEST_DIR)/test_command: $(TEST_DIR)/%: $(TEST_DIR)/%.c $(STUB_SOURCES) $(REACTOR_SOURCES)
+	@echo Host build - $(HOSTCC) $@
+	$(HOSTCC) $(HOSTCFLAGS) $(IDIR) $^ $(REACTOR_WRAP) -lrt -ldl -o $@
+
+# GSC I2C against a fake bus, ioctl() stubbed
+$(TEST_DIR)/test_gsc: $(TEST_DIR)/test_gsc.c $(STUB_SOURCES) $(CORE_SOURCES)
+	@echo Host build - $(HOSTCC) $@
+	$(HOSTCC) $(HOSTCFLAGS) $(IDIR) $^ $(STUB_WRAP),--wrap=ioctl -lrt -ldl -o $@
+
+$(TEST_DIR)/plugin_abi%.so: $(TEST_DIR)/plugin_stub.c
+	$(HOSTCC) $(HOSTCFLAGS) -fPIC -shared -DPLUGIN_STUB_ABI=$* $< -o $@
+
+$(TEST_DIR)/led_sysfs.so: plugins/led_sysfs.c
+	$(HOSTCC) $(HOSTCFLAGS) -fPIC -shared $< -o $@
+
+$(TEST_DIR)/%: $(TEST_DIR)/%.c $(STUB_SOURCES) $(CORE_SOURCES)
+	@echo Host build - $(HOSTCC) $@
+	$(HOSTCC) $(HOSTCFLAGS) $(IDIR) $^ $(STUB_WRAP) -lrt -ldl -o $@
+
+.PHONY: all pb_monitor plugins test bench
 
 clean:	#clean
 	rm -rf *.o
 	rm $(EXECUTABLES)
+	rm -f $(LIBRARY) $(PLUGINS)
+	rm -f $(TEST_DIR)/test_press $(TEST_DIR)/test_command $(TEST_DIR)/test_isolate $(TEST_DIR)/test_reset $(TEST_DIR)/test_deadline $(TEST_DIR)/test_gsc $(TEST_DIR)/test_flightrec $(TEST_DIR)/test_plugin $(TEST_PLUGINS) $(TEST_DIR)/bench_press $(TEST_DIR)/bench_reactor $(TEST_DIR)/led_sysfs.so
@@ -0,0 +1,159 @@
+/**********************************************************************************************************************
+*
+*   File:           led_sysfs.c
+*
+*   Summary:        pb_monitor LED driver plugin writing the LED class sysfs files directly
+*
+*   Element:        IESv06
+*
+*   Platform:       Linux
+*
+*   Description:  Replaces the set_led.sh command with two or three pwrite() calls on files
+*                 opened once at init, or with writes batched into the io_uring reactor's
+*                 submission (led_writes). Same LED mapping as pb_monitor.sh:
+*                   user1 - green (trigger 'heartbeat' to flash), user2 - red.
+*
+*                 Load:  pb_monitor -P /usr/local/lib/pb_monitor/led_sysfs.so[:/sys/class/leds]
+*
+*******************************************************************************************************************/
+
+#include <fcntl.h>
+#include <stdio.h>
+#include <unistd.h>
+
+#include "../pb_plugin.h"
+
+/*
+ * Defines
+ */
+#define LED_SYSFS_DIR   "/sys/class/leds"
+
+/*
+ * Static - sysfs files
+ */
+static int green_trigger = -1;
+static int green_brightness = -1;
+static int red_brightness = -1;
+
+/*
+ **************  Functions  ****************
+ */
+
+/*
+ * led_open
+ *
+ * @brief Opens dir/led/attr for writing.
+ */
+static int led_open( const char *dir, const char *led, const char *attr )
+{
+	char path[256];
+	int fd;
+
+	snprintf(path, sizeof(path), "%s/%s/%s", dir, led, attr);
+	fd = open(path, O_WRONLY | O_CLOEXEC);
+	if (fd == -1)
+	{
+		perror(path);
+	}
+	return(fd);
+}
+
+static int led_sysfs_init( const char *arg )
+{
+	const char *dir = arg ? arg : LED_SYSFS_DIR;
+
+	green_trigger = led_open(dir, "user1", "trigger");
+	green_brightness = led_open(dir, "user1", "brightness");
+	red_brightness = led_open(dir, "user2", "brightness");
+	if ((green_trigger == -1) || (green_brightness == -1) || (red_brightness == -1))
+	{
+		close(green_trigger);
+		close(green_brightness);
+		close(red_brightness);
+		return(-1);
+	}
+	return(0);
+}
+
+/*
+ * led_sysfs_writes
+ *
+ * @brief Describes the sysfs writes for led (ABI 2), so the host can batch them.
+ */
+static int led_sysfs_writes( enum led_state led, struct pb_plugin_write *w, int max )
+{
+	int n = 0;
+
+#define LED_WRITE(file, value)  \
+	do { w[n].fd = (file); w[n].data = (value); w[n].len = sizeof(value) - 1; n++; } while (0)
+
+	if (max < 3)
+		return(-1);
+	switch (led)
+	{
+	case LED_OFF:
+		LED_WRITE(green_trigger, "none");
+		LED_WRITE(green_brightness, "0");
+		LED_WRITE(red_brightness, "0");
+		break;
+	case LED_GREEN:
+		LED_WRITE(green_trigger, "none");
+		LED_WRITE(green_brightness, "255");
+		LED_WRITE(red_brightness, "0");
+		break;
+	case LED_RED:
+		LED_WRITE(green_trigger, "none");
+		LED_WRITE(red_brightness, "255");
+		break;
+	case LED_FLASH_GREEN:
+		/* heartbeat */
+		LED_WRITE(red_brightness, "0");
+		LED_WRITE(green_trigger, "heartbeat");
+		break;
+	case LED_FLASH_RED:
+		LED_WRITE(green_trigger, "heartbeat");
+		LED_WRITE(red_brightness, "255");
+		break;
+	}
+#undef LED_WRITE
+	return(n);
+}
+
+/*
+ * led_sysfs_set
+ *
+ * @brief Drives the LED now - one pwrite per described write.
+ */
+static int led_sysfs_set( enum led_state led )
+{
+	struct pb_plugin_write w[PB_PLUGIN_WRITES_MAX];
+	int i, n;
+	int ret = 0;
+
+	n = led_sysfs_writes(led, w, PB_PLUGIN_WRITES_MAX);
+	for (i = 0; i < n; i++)
+	{
+		if (pwrite(w[i].fd, w[i].data, w[i].len, 0) == -1)
+			ret = -1;
+	}
+	return(ret);
+}
+
+static const struct pb_plugin led_sysfs_plugin = {
+	.abi_version = PB_PLUGIN_ABI_VERSION,
+	.name        = "led_sysfs",
+	.leds        = 1,
+	.init        = led_sysfs_init,
+	.set_led     = led_sysfs_set,
+	.led_writes  = led_sysfs_writes,
+};
+
+/*
+ * pb_plugin_entry
+ *
+ * @brief Plugin entry point.
+ */
+const struct pb_plugin *pb_plugin_entry( void )
+{
+	return(&led_sysfs_plugin);
+}
@@ -0,0 +1,131 @@
+/**********************************************************************************************************************
+*
+*   File:           bench_press.c
+*
+*   Summary:        Host-side microbenchmarks for the press path
+*
+*   Element:        IESv06
+*
+*   Platform:       Linux (host)
+*
+*   Description:  Reports ns/op and heap allocations/op for the timing, classification and
+*                 LED/action dispatch functions, with side effects stubbed (pb_stubs.c).
+*                 Messages printed by the code under test go to /dev/null; results go to stderr.
+*
+*   Run     :    make -f platform_program.mk bench
+*
+*******************************************************************************************************************/
+
+#include <stdint.h>
+#include <stdio.h>
+#include <time.h>
+
+#include "../pb_press.h"
+#include "pb_stubs.h"
+
+/*
+ * Defines
+ */
+#define BENCH_ITERATIONS    1000000
+
+/*
+ * Static - operands, kept out of registers so the calls are not folded away
+ */
+static volatile unsigned long bench_seconds;
+static struct timespec bench_start = { 10, 900000000 };
+static struct timespec bench_stop = { 12, 100000000 };
+
+/*
+ **************  Operations  ****************
+ */
+
+static void op_timespec_diff( void )
+{
+	struct timespec result;
+
+	pb_timespec_diff(&bench_start, &bench_stop, &result);
+}
+
+static void op_test_time( void )
+{
+	struct timespec stop, duration;
+
+	pb_test_time(&bench_start, &stop, &duration);
+}
+
+static void op_process_time_held( void )
+{
+	/* Held press: same threshold, no LED write */
+	pb_process_time(bench_seconds + 6);
+}
+
+static void op_process_time_cross( void )
+{
+	/* Threshold crossing: one LED write per call */
+	pb_threshold_level = 0;
+	pb_process_time(bench_seconds + 5);
+}
+
+static void op_process_end_time_cancel( void )
+{
+	pb_process_end_time(bench_seconds + 20);
+}
+
+static void op_process_end_time_reboot( void )
+{
+	pb_process_end_time(bench_seconds + 1);
+}
+
+static void op_set_led( void )
+{
+	pb_set_led(LED_RED);
+}
+
+/*
+ * bench
+ *
+ * @brief Runs op BENCH_ITERATIONS times and reports ns/op and allocations/op.
+ */
+static void bench( const char *name, void (*op)( void ) )
+{
+	struct timespec t0, t1;
+	uint64_t ns;
+	unsigned long i;
+
+	/* warm up - first use of stdio allocates its buffer */
+	op();
+	stub_reset();
+
+	clock_gettime(CLOCK_MONOTONIC, &t0);
+	for (i = 0; i < BENCH_ITERATIONS; i++)
+	{
+		op();
+	}
+	clock_gettime(CLOCK_MONOTONIC, &t1);
+
+	ns = ((uint64_t)(t1.tv_sec - t0.tv_sec) * 1000000000ULL) + t1.tv_nsec - t0.tv_nsec;
+	fprintf(stderr, "%-28s %10.1f ns/op %8.3f allocs/op\n", name,
+	        (double)ns / BENCH_ITERATIONS, (double)stub_allocs / BENCH_ITERATIONS);
+}
+
+/*
+ ************** main Function  ****************
+ */
+int main( void )
+{
+	if (freopen("/dev/null", "w", stdout) == NULL)
+	{
+		perror("freopen");
+		return(1);
+	}
+	pb_press_state = PB_STATE_INUSE;
+
+	bench("pb_timespec_diff", op_timespec_diff);
+	bench("pb_test_time", op_test_time);
+	bench("pb_process_time (held)", op_process_time_held);
+	bench("pb_process_time (threshold)", op_process_time_cross);
+	bench("pb_process_end_time (cancel)", op_process_end_time_cancel);
+	bench("pb_process_end_time (reboot)", op_process_end_time_reboot);
+	bench("set_led", op_set_led);
+	return(0);
+}
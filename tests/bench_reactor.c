@@ -0,0 +1,257 @@
+/**********************************************************************************************************************
+*
+*   File:           bench_reactor.c
+*
+*   Summary:        Host-side benchmark of the libpbmon epoll and io_uring backends
+*
+*   Element:        IESv06
+*
+*   Platform:       Linux (host)
+*
+*   Description:  Feeds press/release cycles through a FIFO standing in for the input device,
+*                 with the led_sysfs plugin writing to files in a temporary directory, and
+*                 reports ns/cycle and system calls/cycle for each backend. read/write counts
+*                 come from /proc/thread-self/io - this thread only, io_uring's io-wq workers
+*                 are excluded - less the benchmark's own FIFO writes;
+*                 select, epoll_wait and io_uring_enter are counted here and by pb_uring.c.
+*                 Actions are stubbed and the flight recorder disabled (pb_stubs.c).
+*
+*   Run     :    make -f platform_program.mk bench
+*
+*******************************************************************************************************************/
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <time.h>
+#include <unistd.h>
+#include <linux/input.h>
+#include <sys/select.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+
+#include "../pb_plugin.h"
+#include "../pbmon.h"
+#include "pb_stubs.h"
+
+/*
+ * Defines
+ */
+#define BENCH_CYCLES        10000
+#define BENCH_PLUGIN        "./tests/led_sysfs.so"
+
+/*
+ * Static
+ */
+static char bench_dir[] = "/tmp/bench_reactorXXXXXX";
+static char bench_fifo[64];
+static int bench_feed = -1;
+static unsigned long bench_presses, bench_releases;
+static unsigned long bench_selects, bench_dispatches;
+
+/*
+ * Callbacks - count, leave the default actions (stubbed) to pbmon
+ */
+static void bench_press( void *ctx, enum pb_state state )
+{
+	bench_presses++;
+}
+
+static int bench_release( void *ctx, enum pb_state state, unsigned long press_ms, unsigned int decision )
+{
+	bench_releases++;
+	return(0);
+}
+
+static const struct pbmon_callbacks bench_callbacks = {
+	.press   = bench_press,
+	.release = bench_release,
+};
+
+/*
+ * io_counters
+ *
+ * @brief Reads the syscr / syscw counters of /proc/thread-self/io.
+ */
+static void io_counters( unsigned long *syscr, unsigned long *syscw )
+{
+	char line[64];
+	FILE *io = fopen("/proc/thread-self/io", "r");
+
+	*syscr = *syscw = 0;
+	if (io == NULL)
+		return;
+	while (fgets(line, sizeof(line), io) != NULL)
+	{
+		sscanf(line, "syscr: %lu", syscr);
+		sscanf(line, "syscw: %lu", syscw);
+	}
+	fclose(io);
+}
+
+/*
+ * led_files
+ *
+ * @brief Creates (create non-zero) or removes the user1 / user2 LED class files.
+ */
+static int led_files( int create )
+{
+	static const char *files[] = { "user1/trigger", "user1/brightness", "user2/brightness" };
+	char path[128];
+	unsigned int i;
+	int fd;
+
+	if (!create)
+	{
+		for (i = 0; i < sizeof(files) / sizeof(files[0]); i++)
+		{
+			snprintf(path, sizeof(path), "%s/%s", bench_dir, files[i]);
+			unlink(path);
+		}
+		snprintf(path, sizeof(path), "%s/user1", bench_dir);
+		rmdir(path);
+		snprintf(path, sizeof(path), "%s/user2", bench_dir);
+		rmdir(path);
+		return(rmdir(bench_dir));
+	}
+
+	snprintf(path, sizeof(path), "%s/user1", bench_dir);
+	mkdir(path, 0755);
+	snprintf(path, sizeof(path), "%s/user2", bench_dir);
+	mkdir(path, 0755);
+	for (i = 0; i < sizeof(files) / sizeof(files[0]); i++)
+	{
+		snprintf(path, sizeof(path), "%s/%s", bench_dir, files[i]);
+		if ((fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644)) == -1)
+		{
+			perror(path);
+			return(-1);
+		}
+		close(fd);
+	}
+	return(0);
+}
+
+/*
+ * feed
+ *
+ * @brief Writes one button event to the FIFO, then dispatches until count moves.
+ */
+static int feed( int value, unsigned long *count )
+{
+	struct input_event ev;
+	unsigned long before = *count;
+	fd_set rdfs;
+	int fd = pbmon_fd();
+
+	memset(&ev, 0, sizeof(ev));
+	gettimeofday(&ev.time, NULL);
+	ev.type = EV_KEY;
+	ev.code = 256;
+	ev.value = value;
+	if (write(bench_feed, &ev, sizeof(ev)) != sizeof(ev))
+		return(-1);
+
+	while (*count == before)
+	{
+		FD_ZERO(&rdfs);
+		FD_SET(fd, &rdfs);
+		bench_selects++;
+		if (select(fd + 1, &rdfs, NULL, NULL, NULL) <= 0)
+			return(-1);
+		bench_dispatches++;
+		if (pbmon_dispatch() < 0)
+			return(-1);
+	}
+	return(0);
+}
+
+/*
+ * bench
+ *
+ * @brief Runs BENCH_CYCLES press/release cycles on one backend and reports.
+ */
+static int bench( const char *name, int uring )
+{
+	char spec[128];
+	unsigned long r0, w0, r1, w1, enters;
+	struct timespec t0, t1;
+	uint64_t ns;
+	double reads, writes, waits;
+	unsigned long i;
+
+	snprintf(spec, sizeof(spec), "%s:%s", BENCH_PLUGIN, bench_dir);
+	if (pb_plugin_load(spec) < 0)
+		return(-1);
+	pbmon_use_uring(uring);
+	if (pbmon_init(bench_fifo, &bench_callbacks) < 0)
+		return(-1);
+
+	/* warm up */
+	if ((feed(1, &bench_presses) < 0) || (feed(0, &bench_releases) < 0))
+		goto fail;
+	bench_selects = bench_dispatches = 0;
+	enters = pbmon_uring_enters();
+	io_counters(&r0, &w0);
+	clock_gettime(CLOCK_MONOTONIC, &t0);
+	for (i = 0; i < BENCH_CYCLES; i++)
+	{
+		if ((feed(1, &bench_presses) < 0) || (feed(0, &bench_releases) < 0))
+			goto fail;
+	}
+	clock_gettime(CLOCK_MONOTONIC, &t1);
+	io_counters(&r1, &w1);
+	enters = pbmon_uring_enters() - enters;
+
+	ns = ((uint64_t)(t1.tv_sec - t0.tv_sec) * 1000000000ULL) + t1.tv_nsec - t0.tv_nsec;
+	/* one /proc/thread-self/io read (several syscr), two FIFO writes per cycle are ours */
+	reads = (double)(r1 - r0) / BENCH_CYCLES;
+	writes = (double)(w1 - w0 - (2 * BENCH_CYCLES)) / BENCH_CYCLES;
+	waits = (double)bench_selects / BENCH_CYCLES;
+	fprintf(stderr, "%-8s %9.1f ns/cycle  syscalls/cycle: select %.2f read %.2f write %.2f "
+	        "epoll_wait %.2f io_uring_enter %.2f\n", name, (double)ns / BENCH_CYCLES, waits, reads, writes,
+	        uring ? 0.0 : (double)bench_dispatches / BENCH_CYCLES, (double)enters / BENCH_CYCLES);
+	pbmon_close();
+	return(0);
+
+fail:
+	fprintf(stderr, "%s: feed failed\n", name);
+	pbmon_close();
+	return(-1);
+}
+
+/*
+ ************** main Function  ****************
+ */
+int main( void )
+{
+	int ret = 0;
+
+	if (freopen("/dev/null", "w", stdout) == NULL)
+	{
+		perror("freopen");
+		return(1);
+	}
+	if ((mkdtemp(bench_dir) == NULL) || (led_files(1) < 0))
+	{
+		perror("bench dir");
+		return(1);
+	}
+	snprintf(bench_fifo, sizeof(bench_fifo), "%s/event0", bench_dir);
+	/* O_RDWR so neither end blocks opening and the FIFO never sees EOF */
+	if ((mkfifo(bench_fifo, 0600) == -1) || ((bench_feed = open(bench_fifo, O_RDWR)) == -1))
+	{
+		perror(bench_fifo);
+		return(1);
+	}
+
+	if ((bench("epoll", 0) < 0) || (bench("io_uring", 1) < 0))
+		ret = 1;
+
+	close(bench_feed);
+	unlink(bench_fifo);
+	led_files(0);
+	return(ret);
+}
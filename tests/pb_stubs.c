@@ -0,0 +1,128 @@
+/**********************************************************************************************************************
+*
+*   File:           pb_stubs.c
+*
+*   Summary:        Stubbed side effects for host-side tests and benchmarks
+*
+*   Element:        IESv06
+*
+*   Platform:       Linux (host)
+*
+*   Description:  See pb_stubs.h.
+*
+*******************************************************************************************************************/
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "../pb_press.h"
+#include "pb_stubs.h"
+
+/*
+ * Global - test results
+ */
+unsigned int checks;
+unsigned int failures;
+
+/*
+ * Global - what the code under test asked for
+ */
+unsigned long stub_system_calls;
+char stub_last_cmd[STUB_CMD_LEN];
+char stub_cmds[STUB_CMDS][STUB_CMD_LEN];
+unsigned long stub_allocs;
+unsigned long stub_gsc_opens;
+const char *stub_fopen_redirect = "/dev/null";
+
+FILE *__real_fopen( const char *path, const char *mode );
+void *__real_malloc( size_t size );
+void *__real_calloc( size_t nmemb, size_t size );
+void *__real_realloc( void *ptr, size_t size );
+
+/*
+ * stub_reset
+ *
+ * @brief Clears the recorded calls.
+ */
+void stub_reset( void )
+{
+	stub_system_calls = 0;
+	stub_last_cmd[0] = '\0';
+	memset(stub_cmds, 0, sizeof(stub_cmds));
+	stub_allocs = 0;
+}
+
+/*
+ * __wrap_system
+ *
+ * @brief Records the command instead of running it.
+ */
+int __wrap_system( const char *cmd )
+{
+	if (stub_system_calls < STUB_CMDS)
+		strncpy(stub_cmds[stub_system_calls], cmd, STUB_CMD_LEN - 1);
+	stub_system_calls++;
+	strncpy(stub_last_cmd, cmd, STUB_CMD_LEN - 1);
+	stub_last_cmd[STUB_CMD_LEN - 1] = '\0';
+	return(0);
+}
+
+/*
+ * __wrap_fopen
+ *
+ * @brief Redirects the factory reset flag file away from /opt.
+ */
+FILE *__wrap_fopen( const char *path, const char *mode )
+{
+	if (strcmp(path, FACTORY_RESET_FILE) == 0)
+	{
+		path = stub_fopen_redirect;
+	}
+	return(__real_fopen(path, mode));
+}
+
+/*
+ * __wrap_fr_open
+ *
+ * @brief Keeps the flight recorder away from /opt - recording disabled
+ *        (libpbmon tests, linked with --wrap=fr_open).
+ */
+int __wrap_fr_open( const char *path )
+{
+	return(-1);
+}
+
+/*
+ * __wrap_gsc_open
+ *
+ * @brief Keeps pb_initialise() off the host's I2C buses - no GSC
+ *        (libpbmon tests, linked with --wrap=gsc_open).
+ */
+int __wrap_gsc_open( const char *bus, unsigned int addr )
+{
+	stub_gsc_opens++;
+	return(-1);
+}
+
+/*
+ * __wrap_malloc, __wrap_calloc, __wrap_realloc
+ *
+ * @brief Count heap allocations.
+ */
+void *__wrap_malloc( size_t size )
+{
+	stub_allocs++;
+	return(__real_malloc(size));
+}
+
+void *__wrap_calloc( size_t nmemb, size_t size )
+{
+	stub_allocs++;
+	return(__real_calloc(nmemb, size));
+}
+
+void *__wrap_realloc( void *ptr, size_t size )
+{
+	stub_allocs++;
+	return(__real_realloc(ptr, size));
+}
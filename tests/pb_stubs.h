@@ -0,0 +1,49 @@
+/**********************************************************************************************************************
+*
+*   File:           pb_stubs.h
+*
+*   Summary:        Stubbed side effects for host-side tests and benchmarks
+*
+*   Element:        IESv06
+*
+*   Platform:       Linux (host)
+*
+*   Description:  Linked with -Wl,--wrap=system,--wrap=fopen,--wrap=malloc,--wrap=calloc,--wrap=realloc
+*                 so that LED and action commands are recorded instead of run, the factory
+*                 reset flag file is redirected, and heap allocations are counted.
+*                 Tests of the whole library add --wrap=fr_open (flight recorder disabled)
+*                 and --wrap=gsc_open (no I2C access to the host's buses).
+*                 Also the CHECK() macro shared by the tests.
+*
+*******************************************************************************************************************/
+#ifndef PB_STUBS_H
+#define PB_STUBS_H
+
+#include <stdio.h>
+
+/* Counts a check, reports it if it fails - totals in checks and failures */
+#define CHECK(cond)                                                         \
+	do {                                                                    \
+		checks++;                                                           \
+		if (!(cond))                                                        \
+		{                                                                   \
+			failures++;                                                     \
+			printf("FAIL %s:%d: %s\n", __FILE__, __LINE__, #cond);          \
+		}                                                                   \
+	} while (0)
+
+#define STUB_CMD_LEN    128
+#define STUB_CMDS       4       /* first commands kept after stub_reset() */
+
+extern unsigned int checks;
+extern unsigned int failures;
+extern unsigned long stub_system_calls;
+extern char stub_last_cmd[STUB_CMD_LEN];
+extern char stub_cmds[STUB_CMDS][STUB_CMD_LEN];
+extern unsigned long stub_allocs;
+extern unsigned long stub_gsc_opens;
+extern const char *stub_fopen_redirect;
+
+void stub_reset( void );
+
+#endif /* PB_STUBS_H */
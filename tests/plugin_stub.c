@@ -0,0 +1,74 @@
+/**********************************************************************************************************************
+*
+*   File:           plugin_stub.c
+*
+*   Summary:        Test plugin for the plugin loader tests
+*
+*   Element:        IESv06
+*
+*   Platform:       Linux (host)
+*
+*   Description:  Built once per ABI version (-DPLUGIN_STUB_ABI=n) as tests/plugin_abi<n>.so.
+*                 Claims reboot and the LED; execute() and set_led() return values the test
+*                 can tell from the exec fallback, led_writes() describes one write. An
+*                 init argument of "fail" makes init fail.
+*
+*******************************************************************************************************************/
+
+#include <string.h>
+
+#include "../pb_plugin.h"
+
+/*
+ * Defines
+ */
+#define PLUGIN_STUB_STATUS  4200    /* + action, from execute */
+#define PLUGIN_STUB_LED     7       /* from set_led */
+
+/*
+ **************  Functions  ****************
+ */
+
+static int stub_init( const char *arg )
+{
+	return(((arg != NULL) && (strcmp(arg, "fail") == 0)) ? -1 : 0);
+}
+
+static int stub_execute( unsigned int action, const char *cmd )
+{
+	return(PLUGIN_STUB_STATUS + action);
+}
+
+static int stub_set_led( enum led_state led )
+{
+	return(PLUGIN_STUB_LED);
+}
+
+static int stub_led_writes( enum led_state led, struct pb_plugin_write *writes, int max )
+{
+	writes[0].fd = -1;
+	writes[0].data = "1";
+	writes[0].len = 1;
+	return(1);
+}
+
+static const struct pb_plugin stub_plugin = {
+	.abi_version = PLUGIN_STUB_ABI,
+	.name        = "stub",
+	.actions     = PB_PLUGIN_ACTION(FR_DEC_REBOOT),
+	.leds        = 1,
+	.init        = stub_init,
+	.execute     = stub_execute,
+	.set_led     = stub_set_led,
+	.led_writes  = stub_led_writes,
+};
+
+/*
+ * pb_plugin_entry
+ *
+ * @brief Plugin entry point.
+ */
+const struct pb_plugin *pb_plugin_entry( void )
+{
+	return(&stub_plugin);
+}
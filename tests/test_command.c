@@ -0,0 +1,370 @@
+/**********************************************************************************************************************
+*
+*   File:           test_command.c
+*
+*   Summary:        Host-side tests of the command socket
+*
+*   Element:        IESv06
+*
+*   Platform:       Linux (host)
+*
+*   Description:  Parses commands, then drives libpbmon (FIFO as the input device) over
+*                 the socket with both backends: state, virtual press/release and the
+*                 real button taking over, direct action requests and refusals, and the
+*                 round-trip time of a command.
+*                 As root, also peers authenticated by a supplementary group.
+*                 Actions are stubbed and the flight recorder disabled (pb_stubs.c).
+*
+*   Run     :    make -f platform_program.mk test
+*
+*******************************************************************************************************************/
+
+#define _GNU_SOURCE             /* setgroups */
+#include <grp.h>
+#include <signal.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <time.h>
+#include <unistd.h>
+#include <linux/input.h>
+#include <sys/select.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <sys/un.h>
+#include <sys/wait.h>
+
+#include "../pb_command.h"
+#include "../pb_press.h"
+#include "../pbmon.h"
+#include "pb_stubs.h"
+
+/*
+ * Defines
+ */
+#define TEST_ROUND_TRIPS    1000
+#define TEST_GROUP          4242        /* socket group, a peer's supplementary group */
+#define TEST_OTHER_GROUP    4343        /* peer's primary group */
+#define TEST_PEER_UID       65534
+
+static char test_dir[] = "/tmp/test_commandXXXXXX";
+static char test_fifo[64];
+static char test_socket[64];
+static char test_flag[64];          /* factory reset flag file */
+static unsigned long test_keys;     /* press and release callbacks */
+
+/*
+ **************  Helpers  ****************
+ */
+
+/*
+ * request
+ *
+ * @brief Sends cmd, dispatches libpbmon until the reply arrives, returns it in reply.
+ * @return 0, or -1 on failure.
+ */
+static int request( int fd, const char *cmd, char *reply, size_t len )
+{
+	fd_set rdfs;
+	struct timeval timeout;
+	ssize_t n;
+	int pfd = pbmon_fd();
+
+	if (send(fd, cmd, strlen(cmd), 0) == -1)
+		return(-1);
+	for (;;)
+	{
+		n = recv(fd, reply, len - 1, MSG_DONTWAIT);
+		if (n > 0)
+		{
+			reply[n] = '\0';
+			return(0);
+		}
+		FD_ZERO(&rdfs);
+		FD_SET(pfd, &rdfs);
+		timeout.tv_sec = 1;
+		timeout.tv_usec = 0;
+		if (select(pfd + 1, &rdfs, NULL, NULL, &timeout) <= 0)
+			return(-1);
+		if (pbmon_dispatch() < 0)
+			return(-1);
+	}
+}
+
+/*
+ * test_press / test_release
+ *
+ * @brief Callbacks - count the presses and releases, default actions.
+ */
+static void test_press( void *ctx, enum pb_state state )
+{
+	test_keys++;
+}
+
+static int test_release( void *ctx, enum pb_state state, unsigned long press_ms, unsigned int decision )
+{
+	test_keys++;
+	return(0);
+}
+
+static const struct pbmon_callbacks test_callbacks = {
+	.press   = test_press,
+	.release = test_release,
+};
+
+/*
+ * feed_key
+ *
+ * @brief Writes one real button event to the FIFO, then dispatches until it is handled.
+ * @return 0, or -1 on failure.
+ */
+static int feed_key( int feed, int value )
+{
+	struct input_event ev;
+	unsigned long before = test_keys;
+	fd_set rdfs;
+	struct timeval timeout;
+	int pfd = pbmon_fd();
+
+	memset(&ev, 0, sizeof(ev));
+	gettimeofday(&ev.time, NULL);
+	ev.type = EV_KEY;
+	ev.code = 256;
+	ev.value = value;
+	if (write(feed, &ev, sizeof(ev)) != sizeof(ev))
+		return(-1);
+	while (test_keys == before)
+	{
+		FD_ZERO(&rdfs);
+		FD_SET(pfd, &rdfs);
+		timeout.tv_sec = 1;
+		timeout.tv_usec = 0;
+		if ((select(pfd + 1, &rdfs, NULL, NULL, &timeout) <= 0) || (pbmon_dispatch() < 0))
+			return(-1);
+	}
+	return(0);
+}
+
+/*
+ * connect_socket
+ *
+ * @brief Connects to the monitor's command socket.
+ */
+static int connect_socket( void )
+{
+	struct sockaddr_un addr;
+	int fd;
+
+	fd = socket(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0);
+	memset(&addr, 0, sizeof(addr));
+	addr.sun_family = AF_UNIX;
+	strcpy(addr.sun_path, test_socket);
+	if ((fd == -1) || (connect(fd, (struct sockaddr *)&addr, sizeof(addr)) == -1))
+	{
+		perror(test_socket);
+		return(-1);
+	}
+	return(fd);
+}
+
+/*
+ * peer_accept
+ *
+ * @brief Connects from a child running as TEST_PEER_UID, primary group TEST_OTHER_GROUP,
+ *        supplementary group TEST_GROUP, and accepts it for group gid.
+ * @return cmd_accept() result.
+ */
+static int peer_accept( int listen_fd, gid_t gid )
+{
+	gid_t groups[1] = { TEST_GROUP };
+	fd_set rdfs;
+	struct timeval timeout = { 1, 0 };
+	char c;
+	pid_t pid;
+	int fd = -1;
+
+	pid = fork();
+	if (pid == 0)
+	{
+		if ((setgroups(1, groups) == -1) || (setgid(TEST_OTHER_GROUP) == -1) ||
+		    (setuid(TEST_PEER_UID) == -1) || ((fd = connect_socket()) == -1))
+			_exit(1);
+		/* Until the monitor closes */
+		while (read(fd, &c, 1) > 0)
+			;
+		_exit(0);
+	}
+	FD_ZERO(&rdfs);
+	FD_SET(listen_fd, &rdfs);
+	if (select(listen_fd + 1, &rdfs, NULL, NULL, &timeout) == 1)
+		fd = cmd_accept(listen_fd, gid);
+	if (fd != -1)
+		close(fd);
+	else
+		kill(pid, SIGTERM);
+	waitpid(pid, NULL, 0);
+	return(fd);
+}
+
+/*
+ **************  Tests  ****************
+ */
+
+static void test_parse( void )
+{
+	struct cmd cmd;
+
+	CHECK((cmd_parse("press", &cmd) == 0) && (cmd.op == CMD_PRESS));
+	CHECK((cmd_parse("release", &cmd) == 0) && (cmd.op == CMD_RELEASE));
+	CHECK((cmd_parse("state", &cmd) == 0) && (cmd.op == CMD_STATE));
+	CHECK((cmd_parse("action shutdown", &cmd) == 0) && (cmd.op == CMD_ACTION) &&
+	      (cmd.decision == FR_DEC_SHUTDOWN));
+	CHECK((cmd_parse("action factory-reset-next", &cmd) == 0) &&
+	      (cmd.decision == FR_DEC_FACTORY_RESET_NEXT));
+	CHECK(cmd_parse("action", &cmd) == -1);
+	CHECK(cmd_parse("action format-disk", &cmd) == -1);
+	CHECK(cmd_parse("pressed", &cmd) == -1);
+	CHECK(cmd_parse("", &cmd) == -1);
+}
+
+static void test_groups( void )
+{
+	int listen_fd;
+
+	if (geteuid() != 0)
+	{
+		printf("test_command: not root, peer group checks skipped\n");
+		return;
+	}
+	/* The peer reaches the socket by group permission, its group is supplementary */
+	chmod(test_dir, 0711);
+	listen_fd = cmd_open(test_socket, TEST_GROUP);
+	CHECK(listen_fd != -1);
+	if (listen_fd == -1)
+		return;
+	CHECK(peer_accept(listen_fd, TEST_GROUP) != -1);
+	/* Not in the group - refused on credentials, whatever the file mode */
+	chmod(test_socket, 0666);
+	CHECK(peer_accept(listen_fd, TEST_GROUP + 1) == -1);
+	CHECK(peer_accept(listen_fd, CMD_NO_GROUP) == -1);
+	CHECK(peer_accept(listen_fd, TEST_OTHER_GROUP) != -1);
+	cmd_close(test_socket, listen_fd);
+	chmod(test_dir, 0700);
+}
+
+static void test_socket_backend( const char *name, int uring )
+{
+	struct timespec t0, t1;
+	char reply[CMD_LEN];
+	uint64_t ns;
+	int feed, fd, i;
+
+	/* O_RDWR keeps the FIFO open for writing, so the monitor's open does not block */
+	feed = open(test_fifo, O_RDWR);
+	CHECK(feed != -1);
+	pbmon_use_uring(uring);
+	pbmon_use_command(test_socket, CMD_NO_GROUP);
+	CHECK(pbmon_init(test_fifo, &test_callbacks) == 0);
+	CHECK(stub_gsc_opens > 0);
+	fd = connect_socket();
+	CHECK(fd != -1);
+	if (fd == -1)
+		goto out;
+
+	CHECK((request(fd, "state", reply, sizeof(reply)) == 0) && (strcmp(reply, "ok start released") == 0));
+	CHECK((request(fd, "bogus", reply, sizeof(reply)) == 0) && (strcmp(reply, "error unknown command") == 0));
+	CHECK((request(fd, "release", reply, sizeof(reply)) == 0) && (strcmp(reply, "error no virtual press") == 0));
+
+	/* Factory reset in the start-up window, by request */
+	stub_reset();
+	CHECK((request(fd, "action factory-reset", reply, sizeof(reply)) == 0) && (strcmp(reply, "ok") == 0));
+	CHECK(strcmp(stub_cmds[0], "/usr/local/bin/check-factory-reset.sh 1") == 0);
+	CHECK((request(fd, "state", reply, sizeof(reply)) == 0) && (strcmp(reply, "ok in-use released") == 0));
+	CHECK((request(fd, "action factory-reset", reply, sizeof(reply)) == 0) &&
+	      (strcmp(reply, "error not in start-up window") == 0));
+
+	/* Virtual short press in use - reboot through the same path as the button */
+	stub_reset();
+	CHECK((request(fd, "press", reply, sizeof(reply)) == 0) && (strcmp(reply, "ok") == 0));
+	CHECK((request(fd, "state", reply, sizeof(reply)) == 0) && (strcmp(reply, "ok in-use pressed") == 0));
+	CHECK((request(fd, "press", reply, sizeof(reply)) == 0) && (strcmp(reply, "error pressed") == 0));
+	CHECK((request(fd, "action shutdown", reply, sizeof(reply)) == 0) && (strcmp(reply, "error pressed") == 0));
+	CHECK((request(fd, "release\n", reply, sizeof(reply)) == 0) && (strcmp(reply, "ok") == 0));
+	/* then back to the heartbeat LED */
+	CHECK(stub_system_calls == 2);
+	CHECK(strcmp(stub_cmds[0], "reboot") == 0);
+	CHECK(strcmp(stub_last_cmd, "./set_led.sh 3") == 0);
+
+	stub_reset();
+	CHECK((request(fd, "action shutdown", reply, sizeof(reply)) == 0) && (strcmp(reply, "ok") == 0));
+	CHECK(stub_system_calls == 2);
+	CHECK(strcmp(stub_cmds[0], "shutdown -h now") == 0);
+
+	/* The real button takes over a virtual press - the virtual release is refused */
+	CHECK((request(fd, "press", reply, sizeof(reply)) == 0) && (strcmp(reply, "ok") == 0));
+	CHECK(feed_key(feed, 1) == 0);
+	CHECK((request(fd, "release", reply, sizeof(reply)) == 0) && (strcmp(reply, "error no virtual press") == 0));
+	CHECK(feed_key(feed, 0) == 0);
+	CHECK((request(fd, "state", reply, sizeof(reply)) == 0) && (strcmp(reply, "ok in-use released") == 0));
+	/* and a real release ends one - later virtual presses still work */
+	CHECK((request(fd, "press", reply, sizeof(reply)) == 0) && (strcmp(reply, "ok") == 0));
+	CHECK(feed_key(feed, 0) == 0);
+	CHECK((request(fd, "press", reply, sizeof(reply)) == 0) && (strcmp(reply, "ok") == 0));
+	CHECK((request(fd, "release", reply, sizeof(reply)) == 0) && (strcmp(reply, "ok") == 0));
+
+	/* Round trip, including the host's select and dispatch */
+	clock_gettime(CLOCK_MONOTONIC, &t0);
+	for (i = 0; i < TEST_ROUND_TRIPS; i++)
+	{
+		if (request(fd, "state", reply, sizeof(reply)) < 0)
+			break;
+	}
+	clock_gettime(CLOCK_MONOTONIC, &t1);
+	CHECK(i == TEST_ROUND_TRIPS);
+	ns = ((uint64_t)(t1.tv_sec - t0.tv_sec) * 1000000000ULL) + t1.tv_nsec - t0.tv_nsec;
+	printf("test_command: %s round trip %.1f us\n", name, (double)ns / TEST_ROUND_TRIPS / 1000.0);
+	CHECK(ns / TEST_ROUND_TRIPS < 1000000);
+	close(fd);
+
+out:
+	pbmon_close();
+	close(feed);
+	/* socket file removed on close */
+	CHECK(access(test_socket, F_OK) == -1);
+}
+
+/*
+ ************** main Function  ****************
+ */
+int main( void )
+{
+	test_parse();
+
+	if (mkdtemp(test_dir) == NULL)
+	{
+		perror("test dir");
+		return(1);
+	}
+	snprintf(test_fifo, sizeof(test_fifo), "%s/event0", test_dir);
+	snprintf(test_socket, sizeof(test_socket), "%s/pb.sock", test_dir);
+	/* pbmon_init() takes a pending factory reset - never the host's /opt/monitors/fc-set */
+	snprintf(test_flag, sizeof(test_flag), "%s/fc-set", test_dir);
+	pb_factory_reset_file = test_flag;
+	if (mkfifo(test_fifo, 0600) == -1)
+	{
+		perror(test_fifo);
+		return(1);
+	}
+
+	test_groups();
+	test_socket_backend("epoll", 0);
+	test_socket_backend("io_uring", 1);
+
+	unlink(test_fifo);
+	rmdir(test_dir);
+	printf("test_command: %u checks, %u failures\n", checks, failures);
+	return(failures ? 1 : 0);
+}
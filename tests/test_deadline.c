@@ -0,0 +1,277 @@
+/**********************************************************************************************************************
+*
+*   File:           test_deadline.c
+*
+*   Summary:        Host-side tests of the deadline scheduler
+*
+*   Element:        IESv06
+*
+*   Platform:       Linux (host)
+*
+*   Description:  DL_MAX deadlines fired in order with their lateness, O(1) cancel and
+*                 re-arm, removal for owners that free, a full heap, self re-arming
+*                 (periodic) deadlines, and the timerfd waking for the earliest. Prints the
+*                 cost of add, cancel and expiry.
+*
+*   Run     :    make -f platform_program.mk test
+*
+*******************************************************************************************************************/
+
+#include <poll.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "../pb_deadline.h"
+#include "../pb_latency.h"
+#include "../pb_probes.h"
+#include "pb_stubs.h"
+
+/*
+ * Defines
+ */
+#define TEST_NOW_NS         1000000000000ULL    /* fake clock */
+#define TEST_WAKE_NS        20000000ULL         /* timerfd test deadline, 20ms */
+
+static struct dl_timer test_timers[DL_MAX + 1];
+static unsigned int test_fired;
+static unsigned int test_out_of_order;
+static uint64_t test_last_ns;
+static uint64_t test_late_ns;
+
+/*
+ **************  Helpers  ****************
+ */
+
+/*
+ * fired
+ *
+ * @brief Deadline callback - counts, checks the order and keeps the lateness.
+ */
+static void fired( struct dl_timer *timer, uint64_t late_ns )
+{
+	if (timer->deadline_ns < test_last_ns)
+		test_out_of_order++;
+	test_last_ns = timer->deadline_ns;
+	test_late_ns = late_ns;
+	test_fired++;
+}
+
+/*
+ * periodic
+ *
+ * @brief Deadline callback - re-arms itself 1ms on, ctx counts down.
+ */
+static void periodic( struct dl_timer *timer, uint64_t late_ns )
+{
+	unsigned int *left = timer->ctx;
+
+	test_fired++;
+	if (--*left > 0)
+		dl_add(timer, timer->deadline_ns + 1000000ULL);
+}
+
+/*
+ * reset
+ *
+ * @brief Empties the scheduler and re-initialises the test deadlines.
+ */
+static void reset( void )
+{
+	unsigned int i;
+
+	dl_close();
+	for (i = 0; i <= DL_MAX; i++)
+		dl_timer_init(&test_timers[i], fired, NULL);
+	test_fired = 0;
+	test_out_of_order = 0;
+	test_last_ns = 0;
+}
+
+/*
+ * elapsed_ns
+ *
+ * @brief Nanoseconds from start to now.
+ */
+static uint64_t elapsed_ns( uint64_t start )
+{
+	return(pb_time_ns(CLOCK_MONOTONIC) - start);
+}
+
+/*
+ **************  Tests  ****************
+ */
+
+static void test_order( void )
+{
+	uint64_t start, add_ns, cancel_ns, expire_ns;
+	unsigned long lat_count = lat_timer.count;
+	unsigned int i, seed = 1;
+	int full = 0;
+
+	reset();
+	CHECK(dl_next() == 0);
+	CHECK(dl_expire(TEST_NOW_NS) == 0);
+
+	/* Pseudo-random deadlines up to 1s before now */
+	start = pb_time_ns(CLOCK_MONOTONIC);
+	for (i = 0; i < DL_MAX; i++)
+	{
+		seed = (seed * 1103515245) + 12345;
+		if (dl_add(&test_timers[i], TEST_NOW_NS - (seed % 1000000000U)) < 0)
+			full++;
+	}
+	add_ns = elapsed_ns(start);
+	CHECK(full == 0);
+	CHECK(dl_add(&test_timers[DL_MAX], TEST_NOW_NS) == -1);
+	CHECK(!test_timers[DL_MAX].armed);
+
+	/* Cancel every third - in place */
+	start = pb_time_ns(CLOCK_MONOTONIC);
+	for (i = 0; i < DL_MAX; i += 3)
+		dl_cancel(&test_timers[i]);
+	cancel_ns = elapsed_ns(start);
+	CHECK(test_timers[0].index >= 0);
+
+	start = pb_time_ns(CLOCK_MONOTONIC);
+	CHECK(dl_expire(TEST_NOW_NS) == DL_MAX - ((DL_MAX + 2) / 3));
+	expire_ns = elapsed_ns(start);
+	CHECK(test_fired == DL_MAX - ((DL_MAX + 2) / 3));
+	CHECK(test_out_of_order == 0);
+	CHECK(test_late_ns == TEST_NOW_NS - test_last_ns);
+	CHECK(lat_timer.count == lat_count + test_fired);
+	CHECK(dl_next() == 0);
+	for (i = 0, full = 0; i < DL_MAX; i++)
+		full += test_timers[i].armed || (test_timers[i].index != -1);
+	CHECK(full == 0);
+
+	printf("test_deadline: %d deadlines - add %.0f ns, cancel %.1f ns, expire %.0f ns each\n",
+	       DL_MAX, (double)add_ns / DL_MAX, (double)cancel_ns / ((DL_MAX + 2) / 3),
+	       (double)expire_ns / test_fired);
+}
+
+static void test_cancel( void )
+{
+	unsigned int i;
+
+	reset();
+
+	/* Not yet due, then cancelled */
+	dl_add(&test_timers[0], TEST_NOW_NS + 10);
+	dl_add(&test_timers[1], TEST_NOW_NS + 20);
+	CHECK(dl_expire(TEST_NOW_NS) == 0);
+	dl_cancel(&test_timers[0]);
+	CHECK(dl_next() == TEST_NOW_NS + 20);
+	CHECK(test_timers[0].index == -1);
+
+	/* Cancelled in the heap, re-armed earlier - moved, fires once */
+	dl_add(&test_timers[2], TEST_NOW_NS + 30);
+	dl_cancel(&test_timers[2]);
+	dl_add(&test_timers[2], TEST_NOW_NS + 5);
+	CHECK(dl_next() == TEST_NOW_NS + 5);
+	CHECK(dl_expire(TEST_NOW_NS + 30) == 2);
+	CHECK(test_fired == 2);
+
+	/* A full heap of cancelled deadlines is compacted */
+	reset();
+	for (i = 0; i < DL_MAX; i++)
+	{
+		dl_add(&test_timers[i], TEST_NOW_NS + 1000 + i);
+		dl_cancel(&test_timers[i]);
+	}
+	dl_add(&test_timers[DL_MAX - 1], TEST_NOW_NS + 1000);
+	CHECK(dl_add(&test_timers[DL_MAX], TEST_NOW_NS + 1) == 0);
+	CHECK(dl_expire(TEST_NOW_NS + 2000) == 2);
+	CHECK(dl_next() == 0);
+}
+
+static void test_remove( void )
+{
+	unsigned int i, seed = 7;
+	int held = 0;
+
+	/* Removed timers leave the heap at once, the rest still fire in order */
+	reset();
+	for (i = 0; i < 1000; i++)
+	{
+		seed = (seed * 1103515245) + 12345;
+		dl_add(&test_timers[i], TEST_NOW_NS + (seed % 1000000U));
+	}
+	for (i = 0; i < 1000; i += 2)
+		dl_remove(&test_timers[i]);
+	for (i = 0; i < 1000; i++)
+		held += (test_timers[i].index != -1);
+	CHECK(held == 500);
+	CHECK(test_timers[0].index == -1 && !test_timers[0].armed);
+	/* Freed, as far as the scheduler knows */
+	memset(&test_timers[0], 0xff, sizeof(test_timers[0]));
+	dl_remove(&test_timers[1]);
+	dl_remove(&test_timers[1]);
+	CHECK(dl_expire(TEST_NOW_NS + 1000000U) == 499);
+	CHECK(test_out_of_order == 0);
+	CHECK(dl_next() == 0);
+}
+
+static void test_periodic( void )
+{
+	struct dl_timer timer;
+	unsigned int left = 5;
+
+	reset();
+	dl_timer_init(&timer, periodic, &left);
+	dl_add(&timer, TEST_NOW_NS);
+	/* 2.5ms late - catches up three periods, then one at a time */
+	CHECK(dl_expire(TEST_NOW_NS + 2500000ULL) == 3);
+	CHECK(dl_expire(TEST_NOW_NS + 3000000ULL) == 1);
+	CHECK(dl_expire(TEST_NOW_NS + 9000000ULL) == 1);
+	CHECK((left == 0) && !timer.armed && (dl_next() == 0));
+}
+
+static void test_timerfd( void )
+{
+	struct pollfd pfd;
+	uint64_t expirations, now;
+	int late_us;
+
+	reset();
+	pfd.fd = dl_open();
+	pfd.events = POLLIN;
+	CHECK(pfd.fd != -1);
+	if (pfd.fd == -1)
+		return;
+
+	/* Earliest of two, the later one cancelled */
+	now = pb_time_ns(CLOCK_MONOTONIC);
+	dl_add(&test_timers[1], now + (2 * TEST_WAKE_NS));
+	dl_add(&test_timers[0], now + TEST_WAKE_NS);
+	dl_cancel(&test_timers[1]);
+	CHECK(poll(&pfd, 1, 0) == 0);
+	CHECK(poll(&pfd, 1, 1000) == 1);
+	CHECK(elapsed_ns(now) >= TEST_WAKE_NS);
+	CHECK(read(pfd.fd, &expirations, sizeof(expirations)) == sizeof(expirations));
+	CHECK(dl_expire(pb_time_ns(CLOCK_MONOTONIC)) == 1);
+	late_us = (int)(test_late_ns / 1000);
+	printf("test_deadline: timerfd fired %d us after the deadline\n", late_us);
+	CHECK(late_us < 1000000);
+
+	/* Nothing armed - the timerfd stays quiet */
+	CHECK(poll(&pfd, 1, (3 * TEST_WAKE_NS) / 1000000) == 0);
+	dl_close();
+}
+
+/*
+ ************** main Function  ****************
+ */
+int main( void )
+{
+	test_order();
+	test_cancel();
+	test_remove();
+	test_periodic();
+	test_timerfd();
+
+	printf("test_deadline: %u checks, %u failures\n", checks, failures);
+	return(failures ? 1 : 0);
+}
@@ -0,0 +1,268 @@
+/**********************************************************************************************************************
+*
+*   File:           test_flightrec.c
+*
+*   Summary:        Host-side tests of the flight recorder
+*
+*   Element:        IESv06
+*
+*   Platform:       Linux (host)
+*
+*   Description:  Creates a recorder file, wraps the ring, then reopens it as the next boot
+*                 and checks the previous boot's report (oldest first, that boot only), a
+*                 sequence number wrap, and a file with the wrong magic being started again.
+*                 A directory standing in for pstore holds a pmsg copy, reported only when
+*                 the file is new or cannot be opened.
+*
+*   Run     :    make -f platform_program.mk test
+*
+*******************************************************************************************************************/
+
+#define _GNU_SOURCE             /* memmem */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#include "../pb_flightrec.h"
+#include "pb_stubs.h"
+
+/*
+ * Defines
+ */
+#define TEST_EXTRA          10      /* records past a full ring */
+#define TEST_REPORT_LEN     (FR_RECORDS * 128)
+
+static char test_file[] = "/tmp/test_flightrecXXXXXX";
+static char test_pstore_dir[] = "/tmp/test_pstoreXXXXXX";
+static char test_pmsg[64];
+static char test_report[TEST_REPORT_LEN];
+
+/*
+ **************  Helpers  ****************
+ */
+
+/*
+ * load
+ *
+ * @brief Reads the recorder file into file.
+ * @return 0, or -1 if it is not a whole recorder.
+ */
+static int load( struct fr_file *file )
+{
+	int fd;
+	ssize_t n;
+
+	if ((fd = open(test_file, O_RDONLY)) == -1)
+		return(-1);
+	n = pread(fd, file, sizeof(*file), 0);
+	close(fd);
+	return((n == sizeof(*file)) ? 0 : -1);
+}
+
+/*
+ * store
+ *
+ * @brief Writes file back to the recorder file.
+ */
+static void store( const struct fr_file *file )
+{
+	int fd;
+
+	if ((fd = open(test_file, O_WRONLY)) == -1)
+		return;
+	if (pwrite(fd, file, sizeof(*file), 0) != sizeof(*file))
+		perror(test_file);
+	close(fd);
+}
+
+/*
+ * reopen
+ *
+ * @brief Opens the recorder file as a new boot, keeping what it prints in test_report.
+ * @return fr_open() result.
+ */
+static int reopen( const char *file )
+{
+	char path[64];
+	ssize_t n;
+	int fd, out, ret;
+
+	snprintf(path, sizeof(path), "%s.out", test_file);
+	fflush(stdout);
+	out = dup(STDOUT_FILENO);
+	fd = open(path, O_RDWR | O_CREAT | O_TRUNC, 0600);
+	dup2(fd, STDOUT_FILENO);
+	ret = fr_open(file);
+	fflush(stdout);
+	dup2(out, STDOUT_FILENO);
+	close(out);
+	n = pread(fd, test_report, sizeof(test_report) - 1, 0);
+	test_report[(n > 0) ? n : 0] = '\0';
+	close(fd);
+	unlink(path);
+	return(ret);
+}
+
+/*
+ * count_lines
+ *
+ * @brief Number of lines in test_report containing text.
+ */
+static unsigned int count_lines( const char *text )
+{
+	const char *line, *end;
+	unsigned int n = 0;
+
+	for (line = test_report; *line; line = end + 1)
+	{
+		if ((end = strchr(line, '\n')) == NULL)
+			break;
+		if (memmem(line, end - line, text, strlen(text)) != NULL)
+			n++;
+	}
+	return(n);
+}
+
+/*
+ **************  Tests  ****************
+ */
+
+static void test_ring( void )
+{
+	struct fr_file *file = malloc(sizeof(*file));
+	unsigned int i, last, missing = 0;
+	char first[32];
+
+	/* New file - preallocated, first boot */
+	CHECK(reopen(test_file) == 0);
+	CHECK(strstr(test_report, "new recorder file") != NULL);
+	for (i = 0; i < FR_RECORDS + TEST_EXTRA; i++)
+		fr_record(FR_PRESS, 1, 1000 + i);
+	fr_close();
+
+	CHECK(load(file) == 0);
+	CHECK((file->magic == FR_MAGIC) && (file->version == FR_VERSION) && (file->boot == 1));
+	last = 1 + FR_RECORDS + TEST_EXTRA;
+	CHECK(file->seq == last);
+	/* Wrapped - each slot holds the latest record of its sequence number */
+	for (i = 0; i < FR_RECORDS; i++)
+	{
+		if ((file->rec[i].seq & (FR_RECORDS - 1)) != i)
+			missing++;
+	}
+	CHECK(missing == 0);
+	CHECK(file->rec[last & (FR_RECORDS - 1)].value == 1000 + FR_RECORDS + TEST_EXTRA - 1);
+	CHECK(file->rec[last & (FR_RECORDS - 1)].type == FR_PRESS);
+
+	/* Next boot - reports the whole ring of boot 1, oldest first */
+	CHECK(reopen(test_file) == 0);
+	CHECK(count_lines("pb_flightrec: boot 1 ") == FR_RECORDS);
+	snprintf(first, sizeof(first), "boot 1 #%u ", last - FR_RECORDS + 1);
+	CHECK(strncmp(test_report + strlen("pb_flightrec: "), first, strlen(first)) == 0);
+	fr_record(FR_DECISION, 1, FR_DEC_SHUTDOWN);
+	fr_close();
+
+	/* And the one after - only boot 2's records */
+	CHECK(reopen(test_file) == 0);
+	CHECK(count_lines("pb_flightrec: boot 2 ") == 2);
+	CHECK(count_lines("boot 1 ") == 0);
+	CHECK(count_lines("decision shutdown") == 1);
+	fr_close();
+	free(file);
+}
+
+static void test_wrap( void )
+{
+	struct fr_file *file = malloc(sizeof(*file));
+
+	/* Sequence number wrap - 0 means never written, so it is skipped */
+	CHECK(load(file) == 0);
+	file->seq = 0xffffffffU;
+	store(file);
+	CHECK(reopen(test_file) == 0);
+	fr_close();
+	CHECK(load(file) == 0);
+	CHECK((file->seq == 1) && (file->rec[1].seq == 1) && (file->rec[1].type == FR_BOOT));
+
+	/* Not a recorder - started again */
+	file->magic = 0;
+	store(file);
+	CHECK(reopen(test_file) == 0);
+	CHECK(strstr(test_report, "new recorder file") != NULL);
+	fr_close();
+	CHECK(load(file) == 0);
+	CHECK((file->magic == FR_MAGIC) && (file->boot == 1) && (file->seq == 1));
+	free(file);
+}
+
+static void test_pstore( void )
+{
+	struct fr_file *file = malloc(sizeof(*file));
+	FILE *pmsg;
+
+	pmsg = fopen(test_pmsg, "w");
+	CHECK(pmsg != NULL);
+	if (pmsg == NULL)
+		return;
+	fputs("pb_flightrec: boot 7 #3 1700000000.000 state=1 decision reboot\n", pmsg);
+	fclose(pmsg);
+
+	/* File has the previous boot - pstore not needed */
+	CHECK(reopen(test_file) == 0);
+	CHECK(count_lines("boot 7 ") == 0);
+	fr_close();
+
+	/* New file - the previous boot from pstore */
+	CHECK(load(file) == 0);
+	file->magic = 0;
+	store(file);
+	CHECK(reopen(test_file) == 0);
+	CHECK(count_lines("previous boot from ") == 1);
+	CHECK(count_lines("boot 7 #3 ") == 1);
+	fr_close();
+
+	/* Cannot be opened - pstore still reported, recording disabled */
+	CHECK(reopen("/nonexistent/pb_flightrec") == -1);
+	CHECK(count_lines("decision reboot") == 1);
+	unlink(test_pmsg);
+	free(file);
+}
+
+/*
+ ************** main Function  ****************
+ */
+int main( void )
+{
+	int fd;
+
+	if ((fd = mkstemp(test_file)) == -1)
+	{
+		perror("test file");
+		return(1);
+	}
+	close(fd);
+	if (mkdtemp(test_pstore_dir) == NULL)
+	{
+		perror("test pstore");
+		return(1);
+	}
+	/* Never the host's pstore */
+	fr_pstore_dir = test_pstore_dir;
+	snprintf(test_pmsg, sizeof(test_pmsg), "%s/%s0", test_pstore_dir, FR_PSTORE_PMSG);
+
+	test_ring();
+	test_wrap();
+	test_pstore();
+
+	/* Unwritable - recording disabled */
+	CHECK(fr_open("/nonexistent/pb_flightrec") == -1);
+	fr_record(FR_PRESS, 0, 0);
+
+	unlink(test_file);
+	rmdir(test_pstore_dir);
+	printf("test_flightrec: %u checks, %u failures\n", checks, failures);
+	return(failures ? 1 : 0);
+}
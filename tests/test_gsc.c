@@ -0,0 +1,221 @@
+/**********************************************************************************************************************
+*
+*   File:           test_gsc.c
+*
+*   Summary:        Host-side tests of the GSC I2C access
+*
+*   Element:        IESv06
+*
+*   Platform:       Linux (host)
+*
+*   Description:  ioctl() is wrapped by a fake GSC - a register file with R10 write-0-to-clear
+*                 - that can fail the next transfers as a contended bus would. Checks the R0
+*                 read-modify-write, the one-transfer R10 read and clear, retries, back-off
+*                 adaptation and the statistics.
+*
+*   Run     :    make -f platform_program.mk test
+*
+*******************************************************************************************************************/
+
+#include <errno.h>
+#include <stdarg.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/ioctl.h>
+#include <linux/i2c.h>
+#include <linux/i2c-dev.h>
+
+#include "../pb_gsc.h"
+#include "../pb_latency.h"
+#include "pb_stubs.h"
+
+/*
+ * Fake GSC
+ */
+static uint8_t fake_regs[32];
+static uint8_t fake_ptr;
+static unsigned int fake_transfers;     /* I2C_RDWR calls that reached the GSC */
+static unsigned int fake_writes;        /* register writes */
+static unsigned int fake_last_nmsgs;
+static unsigned int fake_fail;          /* fail this many calls ... */
+static int fake_errno;                  /* ... with this */
+static unsigned int fake_calls;
+
+/*
+ **************  Helpers  ****************
+ */
+
+/*
+ * fake_write
+ *
+ * @brief A register write - R10 bits written 0 are cleared, 1 left.
+ */
+static void fake_write( uint8_t reg, uint8_t value )
+{
+	fake_writes++;
+	if (reg == GSC_IRQ_STATUS)
+		fake_regs[reg] &= value;
+	else
+		fake_regs[reg] = value;
+}
+
+/*
+ * __wrap_ioctl
+ *
+ * @brief Serves I2C_RDWR from the fake GSC.
+ */
+int __wrap_ioctl( int fd, unsigned long request, ... )
+{
+	struct i2c_rdwr_ioctl_data *set;
+	struct i2c_msg *msg;
+	unsigned int n;
+	va_list ap;
+
+	va_start(ap, request);
+	set = va_arg(ap, struct i2c_rdwr_ioctl_data *);
+	va_end(ap);
+
+	fake_calls++;
+	if (request != I2C_RDWR)
+	{
+		errno = ENOTTY;
+		return(-1);
+	}
+	if (fake_fail)
+	{
+		fake_fail--;
+		errno = fake_errno;
+		return(-1);
+	}
+	fake_transfers++;
+	fake_last_nmsgs = set->nmsgs;
+	for (n = 0; n < set->nmsgs; n++)
+	{
+		msg = &set->msgs[n];
+		if (msg->addr != GSC_ADDR)
+		{
+			errno = ENXIO;
+			return(-1);
+		}
+		if (msg->flags & I2C_M_RD)
+			msg->buf[0] = fake_regs[fake_ptr];
+		else
+		{
+			fake_ptr = msg->buf[0] % sizeof(fake_regs);
+			if (msg->len > 1)
+				fake_write(fake_ptr, msg->buf[1]);
+		}
+	}
+	return((int)set->nmsgs);
+}
+
+/*
+ * reset
+ *
+ * @brief Resets the fake GSC and the statistics.
+ */
+static void reset( void )
+{
+	memset(fake_regs, 0, sizeof(fake_regs));
+	fake_transfers = fake_writes = fake_last_nmsgs = fake_fail = fake_calls = 0;
+	memset(&gsc_stats, 0, sizeof(gsc_stats));
+	gsc_stats.backoff_us = GSC_BACKOFF_MIN_US;
+}
+
+/*
+ **************  Tests  ****************
+ */
+
+static void test_pb_reset( void )
+{
+	uint8_t value;
+
+	reset();
+	fake_regs[GSC_CTRL_0] = 0xc1;
+	CHECK(gsc_disable_pb_reset() == 0);
+	CHECK(fake_regs[GSC_CTRL_0] == 0xc0);   /* the other bits kept */
+	CHECK(fake_writes == 1);
+
+	/* Already clear - read only */
+	CHECK(gsc_disable_pb_reset() == 0);
+	CHECK(fake_writes == 1);
+	CHECK(gsc_read(GSC_CTRL_0, &value) == 0);
+	CHECK(value == 0xc0);
+	CHECK(gsc_stats.transactions == 4);
+}
+
+static void test_irq_ack( void )
+{
+	uint8_t status = 0;
+
+	reset();
+	fake_regs[GSC_IRQ_STATUS] = GSC_IRQ_PB | GSC_IRQ_GPIO_CHANGE | 0x02;
+	CHECK(gsc_irq_ack(GSC_IRQ_PB | GSC_IRQ_GPIO_CHANGE, &status) == 0);
+	CHECK(fake_transfers == 1);
+	CHECK(fake_last_nmsgs == 3);
+	CHECK(status == (GSC_IRQ_PB | GSC_IRQ_GPIO_CHANGE | 0x02));
+	CHECK(fake_regs[GSC_IRQ_STATUS] == 0x02);   /* another user's interrupt left */
+	CHECK(gsc_irq_ack(GSC_IRQ_PB, NULL) == 0);
+}
+
+static void test_contention( void )
+{
+	unsigned long lat_count = lat_i2c.count;
+	uint8_t value;
+
+	/* Busy twice - retried, back-off raised */
+	reset();
+	fake_regs[3] = 0x5a;
+	fake_fail = 2;
+	fake_errno = EAGAIN;
+	CHECK(gsc_read(3, &value) == 0);
+	CHECK(value == 0x5a);
+	CHECK(fake_calls == 3);
+	CHECK(gsc_stats.retries == 2);
+	CHECK(gsc_stats.failures == 0);
+	CHECK(gsc_stats.backoff_us == 2 * GSC_BACKOFF_MIN_US);
+
+	/* Clean - eases off again, not below the minimum */
+	CHECK(gsc_read(3, &value) == 0);
+	CHECK(gsc_stats.backoff_us == GSC_BACKOFF_MIN_US);
+	CHECK(gsc_read(3, &value) == 0);
+	CHECK(gsc_stats.backoff_us == GSC_BACKOFF_MIN_US);
+
+	/* Never free - gives up after GSC_RETRIES */
+	fake_calls = 0;
+	fake_fail = GSC_RETRIES + 10;
+	fake_errno = EREMOTEIO;
+	CHECK(gsc_read(3, &value) == -1);
+	CHECK(fake_calls == GSC_RETRIES + 1);
+	CHECK(gsc_stats.failures == 1);
+
+	/* Not a bus error - not retried */
+	fake_calls = 0;
+	fake_fail = 1;
+	fake_errno = EINVAL;
+	CHECK(gsc_read(3, &value) == -1);
+	CHECK(fake_calls == 1);
+	CHECK(gsc_stats.failures == 2);
+
+	CHECK(gsc_stats.transactions == 5);
+	CHECK(lat_i2c.count == lat_count + 5);
+	gsc_report();
+}
+
+/*
+ ************** main Function  ****************
+ */
+int main( void )
+{
+	/* ioctl() is wrapped - any descriptor serves as the bus */
+	CHECK(gsc_open("/dev/null", GSC_ADDR) == 0);
+	test_pb_reset();
+	test_irq_ack();
+	test_contention();
+	gsc_close();
+	CHECK(gsc_open("/nonexistent/i2c-0", GSC_ADDR) == -1);
+
+	printf("test_gsc: %u checks, %u failures\n", checks, failures);
+	return(failures ? 1 : 0);
+}
@@ -0,0 +1,198 @@
+/**********************************************************************************************************************
+*
+*   File:           test_isolate.c
+*
+*   Summary:        Host-side tests of action isolation
+*
+*   Element:        IESv06
+*
+*   Platform:       Linux (host)
+*
+*   Description:  I/O priority and spec parsing, and iso_system() against a directory standing
+*                 in for the cgroup v2 mount (its interface files are plain files here, so the
+*                 child's move into the cgroup fails and is reported - the command must still run).
+*
+*   Run     :    make -f platform_program.mk test
+*
+*******************************************************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+
+#include "../pb_flightrec.h"
+#include "../pb_isolate.h"
+#include "pb_stubs.h"
+
+static char test_root[] = "/tmp/test_isolateXXXXXX";
+static const char *test_files[] = {
+	"cgroup.controllers",
+	"cgroup.subtree_control",
+	ISO_CGROUP "/cgroup.subtree_control",
+	ISO_CGROUP "/cpu.weight",
+	ISO_CGROUP "/io.weight",
+};
+
+/*
+ **************  Helpers  ****************
+ */
+
+/*
+ * read_file
+ *
+ * @brief Reads root/name into buf.
+ */
+static const char *read_file( const char *name, char *buf, size_t len )
+{
+	char path[128];
+	ssize_t n;
+	int fd;
+
+	snprintf(path, sizeof(path), "%s/%s", test_root, name);
+	buf[0] = '\0';
+	if ((fd = open(path, O_RDONLY)) == -1)
+		return(buf);
+	n = read(fd, buf, len - 1);
+	buf[(n > 0) ? n : 0] = '\0';
+	close(fd);
+	return(buf);
+}
+
+/*
+ * make_files
+ *
+ * @brief Creates (create non-zero) or removes the fake cgroup tree.
+ */
+static void make_files( int create )
+{
+	char path[128];
+	unsigned int i;
+	int fd;
+
+	snprintf(path, sizeof(path), "%s/%s", test_root, ISO_CGROUP);
+	if (create)
+		mkdir(path, 0755);
+	for (i = 0; i < sizeof(test_files) / sizeof(test_files[0]); i++)
+	{
+		snprintf(path, sizeof(path), "%s/%s", test_root, test_files[i]);
+		if (!create)
+			unlink(path);
+		else if ((fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644)) != -1)
+			close(fd);
+	}
+	if (!create)
+	{
+		snprintf(path, sizeof(path), "%s/%s", test_root, ISO_CGROUP);
+		rmdir(path);
+		rmdir(test_root);
+	}
+}
+
+/*
+ **************  Tests  ****************
+ */
+
+static void test_ioprio( void )
+{
+	CHECK(iso_ioprio("idle") == (3 << 13));
+	CHECK(iso_ioprio("be:7") == ((2 << 13) | 7));
+	CHECK(iso_ioprio("rt:0") == (1 << 13));
+	CHECK(iso_ioprio("be:8") == -1);
+	CHECK(iso_ioprio("be:") == -1);
+	CHECK(iso_ioprio("be:3x") == -1);
+	CHECK(iso_ioprio("low") == -1);
+}
+
+static void test_spec( void )
+{
+	char buf[64];
+
+	/* Checked before anything is written */
+	CHECK(iso_open(test_root, "cpu.weight=10,nice=5") == -1);
+	CHECK(strcmp(read_file(ISO_CGROUP "/cpu.weight", buf, sizeof(buf)), "") == 0);
+	CHECK(strcmp(read_file("cgroup.subtree_control", buf, sizeof(buf)), "") == 0);
+	CHECK(iso_open(test_root, "cpu.weight") == -1);
+	CHECK(iso_open(test_root, "ioprio=be:9") == -1);
+	/* off after a bad spec - plain system(), stubbed */
+	stub_reset();
+	iso_system(FR_DEC_REBOOT, "reboot");
+	CHECK(stub_system_calls == 1);
+}
+
+static void test_system( void )
+{
+	char buf[64];
+	char path[128];
+	struct stat sts;
+	int status;
+
+	CHECK(iso_open(test_root, "cpu.weight=10,io.weight=20,ioprio=be:7") == 0);
+	CHECK(strcmp(read_file("cgroup.subtree_control", buf, sizeof(buf)), ISO_CONTROLLERS) == 0);
+	CHECK(strcmp(read_file(ISO_CGROUP "/cgroup.subtree_control", buf, sizeof(buf)), ISO_CONTROLLERS) == 0);
+	CHECK(strcmp(read_file(ISO_CGROUP "/cpu.weight", buf, sizeof(buf)), "10") == 0);
+	CHECK(strcmp(read_file(ISO_CGROUP "/io.weight", buf, sizeof(buf)), "20") == 0);
+
+	/* Forked, not system() - status as system() */
+	stub_reset();
+	status = iso_system(FR_DEC_SHUTDOWN, "exit 3");
+	CHECK(stub_system_calls == 0);
+	CHECK(WIFEXITED(status) && (WEXITSTATUS(status) == 3));
+	snprintf(path, sizeof(path), "%s/%s/shutdown", test_root, ISO_CGROUP);
+	CHECK((stat(path, &sts) == 0) && S_ISDIR(sts.st_mode));
+
+	/* Removes the (empty) per-action cgroups, back to system() */
+	iso_close();
+	CHECK(stat(path, &sts) == -1);
+	stub_reset();
+	iso_system(FR_DEC_SHUTDOWN, "shutdown -h now");
+	CHECK(stub_system_calls == 1);
+}
+
+static void test_unwritable( void )
+{
+	char path[128];
+	struct stat sts;
+	unsigned int i;
+
+	/* An empty pb_actions has none of the files - the write fails, the group is removed */
+	for (i = 0; i < sizeof(test_files) / sizeof(test_files[0]); i++)
+	{
+		snprintf(path, sizeof(path), "%s/%s", test_root, test_files[i]);
+		if (strchr(test_files[i], '/') != NULL)
+			unlink(path);
+	}
+	snprintf(path, sizeof(path), "%s/%s", test_root, ISO_CGROUP);
+	rmdir(path);
+	CHECK(iso_open(test_root, "cpu.weight=10,memory.max=64M") == -1);
+	CHECK(stat(path, &sts) == -1);
+	stub_reset();
+	iso_system(FR_DEC_REBOOT, "reboot");
+	CHECK(stub_system_calls == 1);
+	make_files(1);
+}
+
+/*
+ ************** main Function  ****************
+ */
+int main( void )
+{
+	if (mkdtemp(test_root) == NULL)
+	{
+		perror("test dir");
+		return(1);
+	}
+	make_files(1);
+
+	test_ioprio();
+	test_spec();
+	test_system();
+	test_unwritable();
+
+	make_files(0);
+	printf("test_isolate: %u checks, %u failures\n", checks, failures);
+	return(failures ? 1 : 0);
+}
@@ -0,0 +1,106 @@
+/**********************************************************************************************************************
+*
+*   File:           test_plugin.c
+*
+*   Summary:        Host-side tests of the plugin loader
+*
+*   Element:        IESv06
+*
+*   Platform:       Linux (host)
+*
+*   Description:  Loads the stub plugin built for ABI versions 0..3 (plugin_stub.c): versions
+*                 outside PB_PLUGIN_ABI_MIN..PB_PLUGIN_ABI_VERSION and a failing init are
+*                 refused, a loaded plugin owns what it claims and everything else falls
+*                 back to the exec plugin (stubbed system()), described LED writes are only
+*                 used from ABI 2, and unloading returns everything to exec.
+*
+*   Run     :    make -f platform_program.mk test
+*
+*******************************************************************************************************************/
+
+#include <stdio.h>
+#include <string.h>
+
+#include "../pb_plugin.h"
+#include "pb_stubs.h"
+
+/*
+ * Defines
+ */
+#define TEST_PLUGIN(abi)    "./tests/plugin_abi" #abi ".so"
+
+static unsigned int test_queued;
+
+/*
+ **************  Helpers  ****************
+ */
+
+/*
+ * queue
+ *
+ * @brief LED write queue - counts the writes.
+ */
+static int queue( const struct pb_plugin_write *write )
+{
+	test_queued++;
+	return(0);
+}
+
+/*
+ **************  Tests  ****************
+ */
+
+static void test_refused( void )
+{
+	stub_reset();
+	CHECK(pb_plugin_load("./tests/nonexistent.so") == -1);
+	CHECK(pb_plugin_load(TEST_PLUGIN(0)) == -1);
+	CHECK(pb_plugin_load(TEST_PLUGIN(3)) == -1);
+	CHECK(pb_plugin_load(TEST_PLUGIN(2) ":fail") == -1);
+
+	/* Nothing loaded - exec runs the commands */
+	CHECK(pb_plugin_execute(FR_DEC_REBOOT, "reboot") == 0);
+	CHECK(pb_plugin_set_led(LED_RED, "./set_led.sh 1") == 0);
+	CHECK(stub_system_calls == 2);
+	CHECK(strcmp(stub_cmds[0], "reboot") == 0);
+	CHECK(strcmp(stub_cmds[1], "./set_led.sh 1") == 0);
+}
+
+static void test_owner( unsigned int abi, const char *path )
+{
+	stub_reset();
+	test_queued = 0;
+	CHECK(pb_plugin_load(path) == 0);
+
+	/* Claimed - the plugin; not claimed - exec */
+	CHECK(pb_plugin_execute(FR_DEC_REBOOT, "reboot") == 4200 + FR_DEC_REBOOT);
+	CHECK(stub_system_calls == 0);
+	CHECK(pb_plugin_execute(FR_DEC_SHUTDOWN, "shutdown -h now") == 0);
+	CHECK((stub_system_calls == 1) && (strcmp(stub_last_cmd, "shutdown -h now") == 0));
+
+	/* LED - set_led, or with a write queue the described writes from ABI 2 */
+	CHECK(pb_plugin_set_led(LED_RED, "./set_led.sh 1") == 7);
+	pb_plugin_set_write_queue(queue);
+	CHECK(pb_plugin_set_led(LED_GREEN, "./set_led.sh 2") == ((abi >= 2) ? 0 : 7));
+	CHECK(test_queued == ((abi >= 2) ? 1 : 0));
+	pb_plugin_set_write_queue(NULL);
+	CHECK(stub_system_calls == 1);
+
+	/* Unloaded - back to exec */
+	pb_plugin_unload();
+	CHECK(pb_plugin_execute(FR_DEC_REBOOT, "reboot") == 0);
+	CHECK(strcmp(stub_last_cmd, "reboot") == 0);
+}
+
+/*
+ ************** main Function  ****************
+ */
+int main( void )
+{
+	test_refused();
+	test_owner(PB_PLUGIN_ABI_MIN, TEST_PLUGIN(1));
+	test_owner(PB_PLUGIN_ABI_VERSION, TEST_PLUGIN(2) ":arg");
+
+	printf("test_plugin: %u checks, %u failures\n", checks, failures);
+	return(failures ? 1 : 0);
+}
@@ -0,0 +1,160 @@
+/**********************************************************************************************************************
+*
+*   File:           test_press.c
+*
+*   Summary:        Host-side unit tests for press timing and classification
+*
+*   Element:        IESv06
+*
+*   Platform:       Linux (host)
+*
+*   Description:  Exercises pb_timespec_diff, pb_test_time, pb_process_time, pb_process_end_time and
+*                 the LED/action dispatch with side effects stubbed (pb_stubs.c).
+*
+*   Run     :    make -f platform_program.mk test
+*
+*******************************************************************************************************************/
+
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#include "../pb_press.h"
+#include "pb_stubs.h"
+
+/*
+ **************  Tests  ****************
+ */
+
+static void test_timespec_diff( void )
+{
+	struct timespec start = { 10, 500000000 };
+	struct timespec stop = { 12, 750000000 };
+	struct timespec result;
+
+	pb_timespec_diff(&start, &stop, &result);
+	CHECK(result.tv_sec == 2);
+	CHECK(result.tv_nsec == 250000000);
+
+	/* nanosecond borrow */
+	stop.tv_sec = 13;
+	stop.tv_nsec = 100000000;
+	pb_timespec_diff(&start, &stop, &result);
+	CHECK(result.tv_sec == 2);
+	CHECK(result.tv_nsec == 600000000);
+}
+
+static void test_test_time( void )
+{
+	struct timespec start = { 0, 0 };
+	struct timespec stop, duration;
+	double t;
+
+	/* no start time */
+	CHECK(pb_test_time(&start, &stop, &duration) == 0);
+
+	clock_gettime(CLOCK_REALTIME, &start);
+	start.tv_sec -= 7;
+	t = pb_test_time(&start, &stop, &duration);
+	CHECK((t >= 7.0) && (t < 8.0));
+	CHECK(duration.tv_sec == 7);
+}
+
+static void test_process_time( void )
+{
+	/* No LED changes in start-up mode */
+	pb_press_state = PB_STATE_START;
+	pb_threshold_level = 0;
+	stub_reset();
+	pb_process_time(12);
+	CHECK(stub_system_calls == 0);
+
+	pb_press_state = PB_STATE_INUSE;
+	stub_reset();
+	pb_process_time(0);
+	pb_process_time(4);
+	CHECK(stub_system_calls == 0);
+
+	pb_process_time(5);
+	CHECK(stub_system_calls == 1);
+	CHECK(strcmp(stub_last_cmd, "./set_led.sh 2") == 0);
+
+	/* LED only written when a threshold is crossed */
+	pb_process_time(6);
+	pb_process_time(9);
+	CHECK(stub_system_calls == 1);
+
+	pb_process_time(10);
+	CHECK(stub_system_calls == 2);
+	CHECK(strcmp(stub_last_cmd, "./set_led.sh 4") == 0);
+
+	pb_process_time(15);
+	CHECK(stub_system_calls == 3);
+	CHECK(strcmp(stub_last_cmd, "./set_led.sh 3") == 0);
+	pb_threshold_level = 0;
+}
+
+static void test_process_end_time( void )
+{
+	pb_press_state = PB_STATE_INUSE;
+
+	stub_reset();
+	pb_process_end_time(2);
+	CHECK(stub_system_calls == 1);
+	CHECK(strcmp(stub_last_cmd, "reboot") == 0);
+
+	stub_reset();
+	pb_process_end_time(7);
+	CHECK(stub_system_calls == 0);
+
+	stub_reset();
+	pb_process_end_time(12);
+	CHECK(stub_system_calls == 1);
+	CHECK(strcmp(stub_last_cmd, "shutdown -h now") == 0);
+
+	stub_reset();
+	pb_process_end_time(20);
+	CHECK(stub_system_calls == 0);
+
+	/* Short press in start-up window - factory reset now, then in-use */
+	pb_press_state = PB_STATE_START;
+	stub_reset();
+	pb_process_end_time(1);
+	CHECK(pb_press_state == PB_STATE_INUSE);
+	CHECK(stub_system_calls == 2);
+	CHECK(strcmp(stub_cmds[0], "/usr/local/bin/check-factory-reset.sh 1") == 0);
+	CHECK(strcmp(stub_last_cmd, "./set_led.sh 3") == 0);
+
+	/* Again - the same command, not one argument longer */
+	pb_press_state = PB_STATE_START;
+	stub_reset();
+	pb_process_end_time(1);
+	CHECK(strcmp(stub_cmds[0], "/usr/local/bin/check-factory-reset.sh 1") == 0);
+}
+
+static void test_dispatch( void )
+{
+	stub_reset();
+	pb_set_led(LED_FLASH_RED);
+	CHECK(stub_system_calls == 1);
+	CHECK(strcmp(stub_last_cmd, "./set_led.sh 4") == 0);
+
+	stub_reset();
+	CHECK(pb_run_action("true", 0) == 0);
+	CHECK(strcmp(stub_last_cmd, "true") == 0);
+}
+
+/*
+ ************** main Function  ****************
+ */
+int main( void )
+{
+	test_timespec_diff();
+	test_test_time();
+	test_process_time();
+	test_process_end_time();
+	test_dispatch();
+
+	printf("test_press: %u checks, %u failures\n", checks, failures);
+	return(failures ? 1 : 0);
+}
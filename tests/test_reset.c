@@ -0,0 +1,269 @@
+/**********************************************************************************************************************
+*
+*   File:           test_reset.c
+*
+*   Summary:        Host-side tests of factory reset by snapshot swap
+*
+*   Element:        IESv06
+*
+*   Platform:       Linux (host)
+*
+*   Description:  Without a data directory, a reset requested through the flag file (moved
+*                 into the test directory) runs the script. Then lays out a data directory
+*                 (pb_reset.h) with a populated generation and resets through the press
+*                 core: the swap and reboot, the old data kept until the next boot, a
+*                 5-10s press swapping straight away, and after a (simulated) reboot the
+*                 background erase with the LED solid green, and a swap made while it runs.
+*
+*   Run     :    make -f platform_program.mk test
+*
+*******************************************************************************************************************/
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#include "../pb_flightrec.h"
+#include "../pb_press.h"
+#include "../pb_reset.h"
+#include "pb_stubs.h"
+
+/*
+ * Defines
+ */
+#define TEST_FILES          1000    /* in the generation to be reset */
+#define TEST_ERASE_WAIT     500     /* 10ms polls */
+
+static char test_dir[] = "/tmp/test_resetXXXXXX";
+static char test_flag[64];          /* factory reset flag file, in test_dir */
+
+/*
+ **************  Helpers  ****************
+ */
+
+/*
+ * exists
+ *
+ * @brief Does test_dir/name exist?
+ */
+static int exists( const char *name )
+{
+	char path[192];
+	struct stat sts;
+
+	snprintf(path, sizeof(path), "%s/%s", test_dir, name);
+	return(lstat(path, &sts) == 0);
+}
+
+/*
+ * current
+ *
+ * @brief Reads the current link.
+ */
+static const char *current( char *buf, size_t len )
+{
+	char path[192];
+	ssize_t n;
+
+	snprintf(path, sizeof(path), "%s/%s", test_dir, RST_CURRENT);
+	n = readlink(path, buf, len - 1);
+	buf[(n > 0) ? n : 0] = '\0';
+	return(buf);
+}
+
+/*
+ * make_generation
+ *
+ * @brief Lays out gen.1 with files in upper, current pointing at it.
+ */
+static void make_generation( void )
+{
+	char path[192];
+	int fd, i;
+
+	snprintf(path, sizeof(path), "%s/gen.1", test_dir);
+	mkdir(path, 0755);
+	snprintf(path, sizeof(path), "%s/gen.1/work", test_dir);
+	mkdir(path, 0755);
+	snprintf(path, sizeof(path), "%s/gen.1/upper", test_dir);
+	mkdir(path, 0755);
+	snprintf(path, sizeof(path), "%s/gen.1/upper/etc", test_dir);
+	mkdir(path, 0755);
+	for (i = 0; i < TEST_FILES; i++)
+	{
+		snprintf(path, sizeof(path), "%s/gen.1/upper/etc/conf%d", test_dir, i);
+		if ((fd = open(path, O_WRONLY | O_CREAT, 0644)) != -1)
+		{
+			write(fd, "user data\n", 10);
+			close(fd);
+		}
+	}
+	snprintf(path, sizeof(path), "%s/%s", test_dir, RST_CURRENT);
+	symlink("gen.1", path);
+}
+
+/*
+ * reboot
+ *
+ * @brief Pretends the swap was made in an earlier boot.
+ */
+static void reboot( void )
+{
+	char path[192];
+	int fd;
+
+	snprintf(path, sizeof(path), "%s/%s", test_dir, RST_PENDING);
+	if ((fd = open(path, O_WRONLY | O_TRUNC)) != -1)
+	{
+		write(fd, "earlier-boot", 12);
+		close(fd);
+	}
+}
+
+/*
+ **************  Tests  ****************
+ */
+
+static void test_unused( void )
+{
+	int time_start = 0;
+	int fd;
+
+	/* No layout - the script as before */
+	CHECK(rst_open(test_dir) == -1);
+	CHECK(rst_swap() == -1);
+	CHECK(rst_cleanup() == 0);
+
+	/* Requested in use last boot - the flag file is taken, the reset runs at start-up */
+	fd = open(test_flag, O_WRONLY | O_CREAT, 0644);
+	CHECK(fd != -1);
+	close(fd);
+	pb_press_state = PB_STATE_START;
+	stub_reset();
+	pb_check_inuse_factory_reset(&time_start);
+	CHECK(access(test_flag, F_OK) == -1);
+	CHECK(strcmp(stub_cmds[0], "/usr/local/bin/check-factory-reset.sh 1") == 0);
+	CHECK((time_start == TIMER1_INTERVAL) && (pb_press_state == PB_STATE_INUSE));
+
+	pb_press_state = PB_STATE_START;
+	stub_reset();
+	pb_process_decision(FR_DEC_FACTORY_RESET);
+	CHECK(strcmp(stub_cmds[0], "/usr/local/bin/check-factory-reset.sh 1") == 0);
+	CHECK(pb_led_idle == LED_FLASH_GREEN);
+}
+
+static void test_swap( void )
+{
+	struct timespec t0, t1;
+	char buf[32];
+
+	make_generation();
+	CHECK(rst_open(test_dir) == 0);
+
+	/* Start-up window press - swap, flash red, reboot */
+	pb_press_state = PB_STATE_START;
+	stub_reset();
+	clock_gettime(CLOCK_MONOTONIC, &t0);
+	pb_process_decision(FR_DEC_FACTORY_RESET);
+	clock_gettime(CLOCK_MONOTONIC, &t1);
+	printf("test_reset: reset of %d files, %.0f us to reboot\n", TEST_FILES,
+	       ((double)(t1.tv_sec - t0.tv_sec) * 1e6) + ((double)(t1.tv_nsec - t0.tv_nsec) / 1e3));
+	CHECK(strcmp(current(buf, sizeof(buf)), "gen.2") == 0);
+	CHECK(exists("gen.2/upper") && exists("gen.2/work"));
+	CHECK(exists(RST_PENDING));
+	CHECK(!exists(RST_CURRENT ".tmp"));
+	CHECK(strcmp(stub_cmds[0], "./set_led.sh 4") == 0);
+	CHECK(strcmp(stub_cmds[1], "reboot") == 0);
+	CHECK(strcmp(stub_last_cmd, "./set_led.sh 4") == 0);
+	CHECK(pb_led_idle == LED_FLASH_RED);
+	pb_led_idle = LED_FLASH_GREEN;
+
+	/* Not rebooted yet - gen.1 is still mounted */
+	CHECK(rst_cleanup() == 0);
+	CHECK(exists("gen.1/upper/etc/conf0"));
+
+	/* In use, 5-10s - swaps at once, no start-up file, no reboot */
+	pb_press_state = PB_STATE_INUSE;
+	stub_reset();
+	pb_process_decision(FR_DEC_FACTORY_RESET_NEXT);
+	CHECK(strcmp(current(buf, sizeof(buf)), "gen.3") == 0);
+	CHECK(stub_system_calls == 0);
+}
+
+static void test_cleanup( void )
+{
+	char buf[32];
+	int time_start = 0;
+	int i;
+
+	/* Next boot - erases gen.1 and gen.2 in the background */
+	reboot();
+	CHECK(rst_open(test_dir) == 0);
+	pb_press_state = PB_STATE_START;
+	stub_reset();
+	pb_check_inuse_factory_reset(&time_start);
+	CHECK(time_start == TIMER1_EXPIRE);
+	CHECK(pb_led_idle == LED_GREEN);
+	CHECK(strcmp(stub_cmds[0], "./set_led.sh 2") == 0);
+	CHECK(!exists(RST_PENDING));
+	CHECK(rst_busy() || !exists("gen.1"));
+
+	/* Swapped again while erasing - the new generation is not touched */
+	CHECK(rst_swap() == 0);
+	CHECK(strcmp(current(buf, sizeof(buf)), "gen.4") == 0);
+
+	for (i = 0; (i < TEST_ERASE_WAIT) && rst_busy(); i++)
+		usleep(10000);
+	CHECK(i < TEST_ERASE_WAIT);
+	CHECK(!exists("gen.1") && !exists("gen.2"));
+	CHECK(exists("gen.3/upper"));
+	CHECK(exists("gen.4/upper") && exists("gen.4/work"));
+	CHECK(strcmp(current(buf, sizeof(buf)), "gen.4") == 0);
+	/* gen.3 stays mounted until the next boot */
+	CHECK(rst_cleanup() == 0);
+	pb_led_idle = LED_FLASH_GREEN;
+}
+
+/*
+ ************** main Function  ****************
+ */
+int main( void )
+{
+	char path[192];
+	int i;
+
+	if (mkdtemp(test_dir) == NULL)
+	{
+		perror("test dir");
+		return(1);
+	}
+	/* Never the host's /opt/monitors/fc-set */
+	snprintf(test_flag, sizeof(test_flag), "%s/fc-set", test_dir);
+	pb_factory_reset_file = test_flag;
+
+	test_unused();
+	test_swap();
+	test_cleanup();
+
+	snprintf(path, sizeof(path), "%s/%s", test_dir, RST_CURRENT);
+	unlink(path);
+	snprintf(path, sizeof(path), "%s/%s", test_dir, RST_PENDING);
+	unlink(path);
+	for (i = 3; i <= 4; i++)
+	{
+		snprintf(path, sizeof(path), "%s/gen.%d/upper", test_dir, i);
+		rmdir(path);
+		snprintf(path, sizeof(path), "%s/gen.%d/work", test_dir, i);
+		rmdir(path);
+		snprintf(path, sizeof(path), "%s/gen.%d", test_dir, i);
+		rmdir(path);
+	}
+	CHECK(rmdir(test_dir) == 0);
+	printf("test_reset: %u checks, %u failures\n", checks, failures);
+	return(failures ? 1 : 0);
+}